@@ -26,10 +26,16 @@
 #include <type_traits>
 #include <thread>
 #include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 
 #include "crow/version.h"
 #include "crow/settings.h"
 #include "crow/logging.h"
+#include "crow/async_logging.h"
 #include "crow/utility.h"
 #include "crow/routing.h"
 #include "crow/middleware_context.h"
@@ -280,6 +286,52 @@ namespace crow
             return max_payload_;
         }
 
+        /// \brief Limit the outgoing queue of every websocket connection (0 - unlimited)
+        ///
+        /// \details A connection whose peer does not read fast enough to stay under the limits is closed
+        /// with PolicyViolated, see websocket::global_send_queue_stats() for counters.
+        self_t& websocket_max_send_queue(uint64_t max_bytes, size_t max_messages)
+        {
+            send_queue_limits_ = {max_bytes, max_messages};
+            return *this;
+        }
+
+        websocket::send_queue_limits websocket_send_queue_limits() const
+        {
+            return send_queue_limits_;
+        }
+
+        /// \brief Ping every websocket connection from the server side (interval 0 - disabled)
+        ///
+        /// \details A connection that stays silent through `max_missed` pings in a row is considered dead and closed,
+        /// see websocket::global_heartbeat_stats() for pong latency and counters.
+        self_t& websocket_heartbeat(std::chrono::milliseconds interval, uint32_t max_missed = 3)
+        {
+            heartbeat_settings_ = {interval, max_missed};
+            return *this;
+        }
+
+        websocket::heartbeat_settings websocket_heartbeat() const
+        {
+            return heartbeat_settings_;
+        }
+
+        /// \brief Limit the incoming message rate of every websocket connection (rate 0 - unlimited)
+        ///
+        /// \details Messages over the limit are dropped before the message handler runs;
+        /// after `max_dropped` drops in a row (0 - never) the connection is closed with PolicyViolated.
+        /// See websocket::global_message_limit_stats() for counters.
+        self_t& websocket_rate_limit(double messages_per_second, double burst, uint32_t max_dropped = 0)
+        {
+            rate_limit_ = {messages_per_second, burst, max_dropped};
+            return *this;
+        }
+
+        websocket::message_rate_limit websocket_rate_limit() const
+        {
+            return rate_limit_;
+        }
+
         self_t& signal_clear()
         {
             signals_.clear();
@@ -297,6 +349,15 @@ namespace crow
             return signals_;
         }
 
+        /// \brief Handle the registered signals with `f` instead of stopping the server
+        ///
+        /// \details The handler runs on the main io_context thread; call `stop()` from it to shut down.
+        self_t& signal_handler(std::function<void(int)> f)
+        {
+            signal_handler_ = std::move(f);
+            return *this;
+        }
+
         /// \brief Set the port that Crow will handle requests on
         self_t& port(std::uint16_t port)
         {
@@ -333,6 +394,47 @@ namespace crow
            return is_bound_;
         }
 
+        /// \brief Use an already bound and listening socket handed over by another process (hot restart)
+        self_t& inherit_acceptor(int native_handle)
+        {
+            inherited_acceptor_ = native_handle;
+            return *this;
+        }
+
+        /// \brief Native handle of the listening socket, -1 if the server is not running
+        int native_acceptor_handle()
+        {
+            if (server_) return server_->native_acceptor_handle();
+            if (unix_server_) return unix_server_->native_acceptor_handle();
+            return -1;
+        }
+
+        /// \brief Stop accepting new connections while existing ones keep running
+        void stop_accepting()
+        {
+            if (server_) server_->stop_accepting();
+            if (unix_server_) unix_server_->stop_accepting();
+        }
+
+        /// \brief The least loaded worker io_context, nullptr if the server is not running
+        asio::io_context* pick_io_context()
+        {
+            if (server_) return &server_->pick_io_context();
+            if (unix_server_) return &unix_server_->pick_io_context();
+            return nullptr;
+        }
+
+        /// \brief Load and traffic counters of the worker threads, to be summed by the caller
+        std::vector<detail::io_context_load*> io_context_loads()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (ssl_server_) return ssl_server_->io_context_loads();
+#endif
+            if (server_) return server_->io_context_loads();
+            if (unix_server_) return unix_server_->io_context_loads();
+            return {};
+        }
+
         /// \brief Set the connection timeout in seconds (default is 5)
         self_t& timeout(std::uint8_t timeout)
         {
@@ -374,6 +476,15 @@ namespace crow
             return bindaddr_;
         }
 
+        /// \brief Set access permissions of the unix domain socket file, e.g. 0660 (0 - as created under the umask)
+        ///
+        /// \details A socket inherited on hot restart keeps the permissions it already has.
+        self_t& local_socket_permissions(unsigned mode)
+        {
+            local_socket_mode_ = mode;
+            return *this;
+        }
+
         /// \brief Run the server on multiple threads using all available threads
         self_t& multithreaded()
         {
@@ -395,6 +506,47 @@ namespace crow
             return concurrency_;
         }
 
+        /// \brief Pin worker threads to CPUs: worker i runs on cpus[i % cpus.size()]
+        self_t& cpu_affinity(std::vector<int> cpus)
+        {
+            cpu_affinity_ = std::move(cpus);
+            return *this;
+        }
+
+        /// \brief Set TCP options for every accepted connection (ignored by unix socket listeners)
+        self_t& socket_options(const crow::socket_options& options)
+        {
+            socket_options_ = options;
+            return *this;
+        }
+
+        const crow::socket_options& socket_options() const
+        {
+            return socket_options_;
+        }
+
+        /// \brief Give every worker thread its own SO_REUSEPORT acceptor instead of accepting on the main thread
+        ///
+        /// The kernel spreads new connections between the acceptors, and each connection is served by the thread that accepted it.
+        /// Linux TCP listeners only; elsewhere the server falls back to a single acceptor.
+        self_t& reuse_port_acceptors(bool enabled = true)
+        {
+            reuse_port_ = enabled;
+            return *this;
+        }
+
+        bool reuse_port_acceptors() const
+        {
+            return reuse_port_;
+        }
+
+        /// \brief Name server threads "<prefix>-<i>" (workers) and "<prefix>-main" (acceptor)
+        self_t& thread_name_prefix(std::string prefix)
+        {
+            thread_name_prefix_ = std::move(prefix);
+            return *this;
+        }
+
         /// \brief Set the server's log level
         ///
         /// Possible values are:
@@ -543,8 +695,12 @@ namespace crow
                 }
                 tcp::endpoint endpoint(addr, port_);
                 router_.using_ssl = true;
-                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, &ssl_context_)));
+                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, &ssl_context_, -1, reuse_port_)));
                 ssl_server_->set_tick_function(tick_interval_, tick_function_);
+                ssl_server_->set_cpu_affinity(cpu_affinity_);
+                ssl_server_->set_thread_name_prefix(thread_name_prefix_);
+                ssl_server_->set_socket_options(socket_options_);
+                ssl_server_->set_signal_handler(signal_handler_);
                 ssl_server_->signal_clear();
                 for (auto snum : signals_)
                 {
@@ -559,8 +715,18 @@ namespace crow
                 if (use_unix_)
                 {
                     UnixSocketAcceptor::endpoint endpoint(bindaddr_);
-                    unix_server_ = std::move(std::unique_ptr<unix_server_t>(new unix_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr)));
+                    unix_server_ = std::move(std::unique_ptr<unix_server_t>(new unix_server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr, inherited_acceptor_)));
+#ifndef _WIN32
+                    if (local_socket_mode_ != 0 && inherited_acceptor_ < 0 && ::chmod(bindaddr_.c_str(), static_cast<mode_t>(local_socket_mode_)) != 0)
+                    {
+                        CROW_LOG_WARNING << "Cannot change permissions of " << bindaddr_ << ": " << std::strerror(errno);
+                    }
+#endif
                     unix_server_->set_tick_function(tick_interval_, tick_function_);
+                    unix_server_->set_cpu_affinity(cpu_affinity_);
+                    unix_server_->set_thread_name_prefix(thread_name_prefix_);
+                    unix_server_->set_socket_options(socket_options_);
+                    unix_server_->set_signal_handler(signal_handler_);
                     for (auto snum : signals_)
                     {
                         unix_server_->signal_add(snum);
@@ -577,8 +743,12 @@ namespace crow
                         return;
                     }
                     TCPAcceptor::endpoint endpoint(addr, port_);
-                    server_ = std::move(std::unique_ptr<server_t>(new server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr)));
+                    server_ = std::move(std::unique_ptr<server_t>(new server_t(this, endpoint, server_name_, &middlewares_, concurrency_, timeout_, nullptr, inherited_acceptor_, reuse_port_)));
                     server_->set_tick_function(tick_interval_, tick_function_);
+                    server_->set_cpu_affinity(cpu_affinity_);
+                    server_->set_thread_name_prefix(thread_name_prefix_);
+                    server_->set_socket_options(socket_options_);
+                    server_->set_signal_handler(signal_handler_);
                     for (auto snum : signals_)
                     {
                         server_->signal_add(snum);
@@ -619,21 +789,29 @@ namespace crow
 
         void close_websockets()
         {
-            for (auto websocket : websockets_)
+            for (auto websocket : websockets())
             {
                 CROW_LOG_INFO << "Quitting Websocket: " << websocket;
                 websocket->close("Websocket Closed");
             }
         }
 
+        /// \brief Snapshot of the open websocket connections
+        std::vector<std::shared_ptr<websocket::connection>> websockets()
+        {
+            std::lock_guard<std::mutex> lock(websockets_mutex_);
+            return websockets_;
+        }
 
         void add_websocket(std::shared_ptr<websocket::connection> conn)
         {
+            std::lock_guard<std::mutex> lock(websockets_mutex_);
             websockets_.push_back(conn);
         }
 
         void remove_websocket(std::shared_ptr<websocket::connection> conn)
         {
+            std::lock_guard<std::mutex> lock(websockets_mutex_);
             websockets_.erase(std::remove(websockets_.begin(), websockets_.end(), conn), websockets_.end());
         }
 
@@ -813,11 +991,20 @@ namespace crow
         std::uint8_t timeout_{5};
         uint16_t port_ = 80;
         unsigned int concurrency_ = 2;
+        std::vector<int> cpu_affinity_;
+        std::string thread_name_prefix_;
         std::atomic_bool is_bound_ = false;
         uint64_t max_payload_{UINT64_MAX};
+        websocket::send_queue_limits send_queue_limits_;
+        websocket::heartbeat_settings heartbeat_settings_;
+        websocket::message_rate_limit rate_limit_;
+        crow::socket_options socket_options_;
         std::string server_name_ = std::string("Crow/") + VERSION;
         std::string bindaddr_ = "0.0.0.0";
         bool use_unix_ = false;
+        unsigned local_socket_mode_ = 0;
+        int inherited_acceptor_ = -1;
+        bool reuse_port_ = false;
         size_t res_stream_threshold_ = 1048576;
         Router router_;
         bool static_routes_added_{false};
@@ -842,10 +1029,12 @@ namespace crow
         std::unique_ptr<unix_server_t> unix_server_;
 
         std::vector<int> signals_{SIGINT, SIGTERM};
+        std::function<void(int)> signal_handler_;
 
         bool server_started_{false};
         std::condition_variable cv_started_;
         std::mutex start_mutex_;
+        std::mutex websockets_mutex_;
         std::vector<std::shared_ptr<websocket::connection>> websockets_;
     };
 
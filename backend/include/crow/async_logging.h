@@ -0,0 +1,296 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include "crow/logging.h"
+
+namespace crow
+{
+    /// Log handler that never makes the logging thread wait for output.
+    ///
+    /// Every thread appends records to its own single-producer ring buffer, without locks;
+    /// a background thread drains all rings, formats the records and writes them in batches.
+    /// A full ring drops the record and counts it instead of waiting, so a slow terminal or disk
+    /// cannot stall io threads. Records keep the time they were logged at and, within a thread, their order.
+    ///
+    /// Install it with `crow::logger::setHandler(&handler)`; it uninstalls itself when destroyed.
+    class AsyncLogHandler : public ILogHandler
+    {
+    public:
+        enum class Format
+        {
+            Text, ///< "(time) [LEVEL   ] thread: message", as the default handler plus thread name and milliseconds
+            Json, ///< One JSON object per line: time, level, thread, message
+        };
+
+        /// \param ring_capacity records buffered per thread, rounded up to a power of two
+        explicit AsyncLogHandler(size_t ring_capacity = 4096, Format format = Format::Text, std::FILE* out = stderr):
+          capacity_(round_up_pow2(ring_capacity)),
+          format_(format),
+          out_(out),
+          id_(next_id()),
+          writer_([this] {
+              run();
+          })
+        {}
+
+        ~AsyncLogHandler() override
+        {
+            if (logger::getHandler() == this)
+                logger::setHandler(nullptr);
+            stopping_ = true;
+            writer_.join();
+            drain();
+        }
+
+        AsyncLogHandler(const AsyncLogHandler&) = delete;
+        AsyncLogHandler& operator=(const AsyncLogHandler&) = delete;
+
+        void log(const std::string& message, LogLevel level) override
+        {
+            ring& r = local_ring();
+            size_t head = r.head.load(std::memory_order_relaxed);
+            if (head - r.tail.load(std::memory_order_acquire) == capacity_)
+            {
+                r.dropped.store(r.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return;
+            }
+            record& slot = r.slots[head & (capacity_ - 1)];
+            slot.time = std::chrono::system_clock::now();
+            slot.level = level;
+            slot.message.assign(message); // Slots keep their capacity, so steady logging does not allocate
+            r.head.store(head + 1, std::memory_order_release);
+        }
+
+        /// Records dropped because a thread's ring was full
+        uint64_t dropped()
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            uint64_t total = 0;
+            for (auto& r : rings_)
+                total += r->dropped.load(std::memory_order_relaxed);
+            return total;
+        }
+
+    private:
+        struct record
+        {
+            std::chrono::system_clock::time_point time;
+            LogLevel level{LogLevel::Info};
+            std::string message;
+        };
+
+        struct ring
+        {
+            ring(size_t capacity, std::string name):
+              slots(capacity), thread_name(std::move(name))
+            {}
+
+            std::vector<record> slots;
+            std::string thread_name;
+            alignas(64) std::atomic<size_t> head{0}; ///< Written by the logging thread
+            std::atomic<uint64_t> dropped{0};        ///< Written by the logging thread
+            alignas(64) std::atomic<size_t> tail{0}; ///< Written by the writer thread
+            uint64_t reported_dropped{0};            ///< Writer thread only
+        };
+
+        static size_t round_up_pow2(size_t n)
+        {
+            size_t capacity = 1;
+            while (capacity < n)
+                capacity <<= 1;
+            return capacity;
+        }
+
+        static uint64_t next_id()
+        {
+            static std::atomic<uint64_t> id{0};
+            return ++id;
+        }
+
+        static std::string current_thread_name(size_t index)
+        {
+#ifdef __linux__
+            char name[16] = {};
+            if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0 && name[0] != '\0')
+                return name;
+#endif
+            return "thread-" + std::to_string(index);
+        }
+
+        /// The calling thread's ring, created on its first record
+        ring& local_ring()
+        {
+            // Keyed by handler id, not address: a new handler may reuse a destroyed one's memory
+            thread_local uint64_t owner = 0;
+            thread_local ring* local = nullptr;
+            if (owner != id_)
+            {
+                std::lock_guard<std::mutex> lock(rings_mutex_);
+                rings_.push_back(std::make_unique<ring>(capacity_, current_thread_name(rings_.size())));
+                local = rings_.back().get();
+                owner = id_;
+            }
+            return *local;
+        }
+
+        void run()
+        {
+            while (!stopping_)
+            {
+                if (!drain())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        /// Write out everything logged so far; false if there was nothing
+        bool drain()
+        {
+            std::vector<ring*> rings;
+            {
+                std::lock_guard<std::mutex> lock(rings_mutex_);
+                for (auto& r : rings_)
+                    rings.push_back(r.get());
+            }
+
+            buffer_.clear();
+            for (ring* r : rings)
+            {
+                size_t tail = r->tail.load(std::memory_order_relaxed);
+                size_t head = r->head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail)
+                    format(*r, r->slots[tail & (capacity_ - 1)], buffer_);
+                r->tail.store(tail, std::memory_order_release);
+
+                uint64_t dropped = r->dropped.load(std::memory_order_relaxed);
+                if (dropped != r->reported_dropped)
+                {
+                    record note{std::chrono::system_clock::now(), LogLevel::Warning,
+                                std::to_string(dropped - r->reported_dropped) + " log records dropped, buffer full"};
+                    r->reported_dropped = dropped;
+                    format(*r, note, buffer_);
+                }
+            }
+            if (buffer_.empty())
+                return false;
+            std::fwrite(buffer_.data(), 1, buffer_.size(), out_);
+            std::fflush(out_);
+            return true;
+        }
+
+        void format(const ring& r, const record& rec, std::string& out)
+        {
+            if (format_ == Format::Json)
+            {
+                out.append("{\"time\":\"");
+                append_time(rec.time, 'T', out);
+                out.append("Z\",\"level\":\"").append(level_name(rec.level, true));
+                out.append("\",\"thread\":\"");
+                append_escaped(r.thread_name, out);
+                out.append("\",\"message\":\"");
+                append_escaped(rec.message, out);
+                out.append("\"}\n");
+            }
+            else
+            {
+                out.push_back('(');
+                append_time(rec.time, ' ', out);
+                out.append(") [").append(level_name(rec.level, false)).append("] ");
+                out.append(r.thread_name).append(": ").append(rec.message).push_back('\n');
+            }
+        }
+
+        static const char* level_name(LogLevel level, bool json)
+        {
+            switch (level)
+            {
+                case LogLevel::Debug: return json ? "debug" : "DEBUG   ";
+                case LogLevel::Info: return json ? "info" : "INFO    ";
+                case LogLevel::Warning: return json ? "warning" : "WARNING ";
+                case LogLevel::Error: return json ? "error" : "ERROR   ";
+                default: return json ? "critical" : "CRITICAL";
+            }
+        }
+
+        /// "YYYY-MM-DD HH:MM:SS.mmm" in UTC (or local time with CROW_USE_LOCALTIMEZONE), like the default handler
+        void append_time(std::chrono::system_clock::time_point time, char separator, std::string& out)
+        {
+            auto since_epoch = time.time_since_epoch();
+            time_t seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count();
+            if (seconds != cached_second_)
+            {
+                tm my_tm;
+#ifdef CROW_USE_LOCALTIMEZONE
+                localtime_r(&seconds, &my_tm);
+#else
+                gmtime_r(&seconds, &my_tm);
+#endif
+                char date[32];
+                size_t size = strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &my_tm);
+                cached_date_.assign(date, size);
+                cached_second_ = seconds;
+            }
+            size_t start = out.size();
+            out.append(cached_date_);
+            out[start + 10] = separator;
+
+            auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch).count() % 1000;
+            char fraction[8];
+            std::snprintf(fraction, sizeof(fraction), ".%03d", static_cast<int>(millis));
+            out.append(fraction);
+        }
+
+        static void append_escaped(const std::string& text, std::string& out)
+        {
+            for (char c : text)
+            {
+                switch (c)
+                {
+                    case '"': out.append("\\\""); break;
+                    case '\\': out.append("\\\\"); break;
+                    case '\n': out.append("\\n"); break;
+                    case '\r': out.append("\\r"); break;
+                    case '\t': out.append("\\t"); break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20)
+                        {
+                            char escaped[8];
+                            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                            out.append(escaped);
+                        }
+                        else
+                            out.push_back(c);
+                }
+            }
+        }
+
+        const size_t capacity_;
+        const Format format_;
+        std::FILE* const out_;
+        const uint64_t id_;
+
+        std::mutex rings_mutex_;
+        std::vector<std::unique_ptr<ring>> rings_;
+
+        // Writer thread only
+        std::string buffer_;
+        std::string cached_date_;
+        time_t cached_second_{-1};
+
+        std::atomic<bool> stopping_{false};
+        std::thread writer_;
+    };
+} // namespace crow
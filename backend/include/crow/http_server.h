@@ -20,14 +20,23 @@
 #include <cstdint>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <thread>
 #include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <unistd.h>
 
 #include "crow/version.h"
 #include "crow/http_connection.h"
 #include "crow/logging.h"
 #include "crow/task_timer.h"
 #include "crow/socket_acceptors.h"
+#include "crow/io_context_load.h"
+#include "crow/socket_options.h"
 
 
 namespace crow // NOTE: Already documented in "crow/app.h"
@@ -51,7 +60,9 @@ namespace crow // NOTE: Already documented in "crow/app.h"
              std::tuple<Middlewares...>* middlewares = nullptr,
              unsigned int concurrency = 1,
              uint8_t timeout = 5,
-             typename Adaptor::context* adaptor_ctx = nullptr):
+             typename Adaptor::context* adaptor_ctx = nullptr,
+             int inherited_acceptor = -1,
+             bool reuse_port = false):
           concurrency_(concurrency),
           task_queue_length_pool_(concurrency_ - 1),
           acceptor_(io_context_),
@@ -61,6 +72,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
           timeout_(timeout),
           server_name_(server_name),
           middlewares_(middlewares),
+          reuse_port_(reuse_port),
           adaptor_ctx_(adaptor_ctx)
         {
             if (startup_failed_) {
@@ -70,6 +82,17 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 
             error_code ec;
 
+            // Listening socket handed over by the previous process (hot restart): already bound and listening
+            if (inherited_acceptor >= 0)
+            {
+                acceptor_.raw_acceptor().assign(endpoint.protocol(), inherited_acceptor, ec);
+                if (ec) {
+                    CROW_LOG_ERROR << "Failed to adopt inherited acceptor: " << ec.message();
+                    startup_failed_ = true;
+                }
+                return;
+            }
+
             acceptor_.raw_acceptor().open(endpoint.protocol(), ec);
             if (ec) {
                 CROW_LOG_ERROR << "Failed to open acceptor: " << ec.message();
@@ -83,7 +106,14 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 startup_failed_ = true;
                 return;
             }
+            // Worker acceptors join this socket on the same port in run()
+            if (reuse_port_ && !set_reuse_port(acceptor_))
+            {
+                CROW_LOG_WARNING << "SO_REUSEPORT is not supported, connections are accepted on the main thread";
+                reuse_port_ = false;
+            }
 
+            Acceptor::prepare_bind(endpoint);
             acceptor_.raw_acceptor().bind(endpoint, ec);
             if (ec) {
                 CROW_LOG_ERROR << "Failed to bind to " << acceptor_.address()
@@ -108,6 +138,24 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             tick_function_ = f;
         }
 
+        /// Pin worker thread i to cpus[i % cpus.size()] (empty - no pinning)
+        void set_cpu_affinity(std::vector<int> cpus)
+        {
+            cpu_affinity_ = std::move(cpus);
+        }
+
+        /// Name threads "<prefix>-<i>" for workers and "<prefix>-main" for the acceptor (empty - keep default names)
+        void set_thread_name_prefix(std::string prefix)
+        {
+            thread_name_prefix_ = std::move(prefix);
+        }
+
+        /// Options applied to every accepted socket
+        void set_socket_options(const socket_options& options)
+        {
+            socket_options_ = options;
+        }
+
         void on_tick()
         {
             tick_function_();
@@ -132,6 +180,10 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 io_context_pool_.emplace_back(new asio::io_context());
             get_cached_date_str_pool_.resize(worker_thread_count);
             task_timer_pool_.resize(worker_thread_count);
+            if (reuse_port_ && !open_worker_acceptors())
+            {
+                CROW_LOG_WARNING << "Cannot open SO_REUSEPORT acceptors, connections are accepted on the main thread";
+            }
 
             std::vector<std::future<void>> v;
             std::atomic<int> init_count(0);
@@ -166,6 +218,8 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                             return date_str;
                         };
 
+                        setup_current_thread(std::to_string(i), i);
+
                         // initializing task timers
                         detail::task_timer task_timer(*io_context_pool_[i]);
                         task_timer.set_default_timeout(timeout_);
@@ -200,25 +254,32 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                       on_tick();
                   });
             }
-            handler_->port(acceptor_.port());
+            handler_->port(listener().port());
             handler_->address_is_bound();
             CROW_LOG_INFO << server_name_ 
-                          << " server is running at " << acceptor_.url_display(handler_->ssl_used()) 
-                          << " using " << concurrency_ << " threads";
+                          << " server is running at " << listener().url_display(handler_->ssl_used()) 
+                          << " using " << concurrency_ << " threads and " << io_backend_name()
+                          << (worker_acceptors_.empty() ? "" : ", an acceptor per thread");
             CROW_LOG_INFO << "Call `app.loglevel(crow::LogLevel::Warning)` to hide Info level logs.";
 
-            signals_.async_wait(
-              [&](const error_code& /*error*/, int /*signal_number*/) {
-                  stop();
-              });
+            wait_for_signal();
 
             while (worker_thread_count != init_count)
                 std::this_thread::yield();
 
-            do_accept();
+            if (worker_acceptors_.empty())
+                do_accept();
+            else
+            {
+                for (size_t i = 0; i < worker_acceptors_.size(); i++)
+                    asio::post(*io_context_pool_[i], [this, i] {
+                        do_worker_accept(i);
+                    });
+            }
 
             std::thread(
               [this] {
+                  setup_current_thread("main", -1);
                   notify_start();
                   io_context_.run();
                   CROW_LOG_INFO << "Exiting.";
@@ -243,6 +304,11 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                     CROW_LOG_WARNING << "Failed to close acceptor: " << ec.message();
                 }
             }
+            for (auto& acceptor : worker_acceptors_)
+            {
+                error_code ec;
+                acceptor->raw_acceptor().close(ec);
+            }
 
             for (auto& io_context : io_context_pool_)
             {
@@ -259,7 +325,44 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 
         
         uint16_t port() const {
-            return acceptor_.local_endpoint().port();
+            return listener().local_endpoint().port();
+        }
+
+        /// Native handle of the listening socket (to pass it to another process).
+        /// With an acceptor per thread this is the first one; the new process adds its own acceptors to the port.
+        int native_acceptor_handle()
+        {
+            return listener().raw_acceptor().native_handle();
+        }
+
+        /// Stop accepting new connections; existing connections keep running
+        void stop_accepting()
+        {
+            shutting_down_ = true;
+            asio::post(io_context_, [this] {
+                error_code ec;
+                acceptor_.raw_acceptor().close(ec);
+            });
+            for (size_t i = 0; i < worker_acceptors_.size(); i++)
+                asio::post(*io_context_pool_[i], [this, i] {
+                    error_code ec;
+                    worker_acceptors_[i]->raw_acceptor().close(ec);
+                });
+        }
+
+        /// Load and traffic counters of every worker io_context; empty until the server runs
+        std::vector<detail::io_context_load*> io_context_loads()
+        {
+            std::vector<detail::io_context_load*> loads;
+            for (auto& io_context : io_context_pool_)
+                loads.push_back(&detail::io_context_load::of(*io_context));
+            return loads;
+        }
+
+        /// The least loaded worker io_context (for connections created outside the acceptor)
+        asio::io_context& pick_io_context()
+        {
+            return *io_context_pool_[pick_io_context_idx()];
         }
 
         /// Wait until the server has properly started or until timeout
@@ -284,21 +387,173 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             signals_.add(signal_number);
         }
 
+        /// Handle signals with `f` instead of stopping the server; the handler runs on the main io_context
+        void set_signal_handler(std::function<void(int)> f)
+        {
+            signal_handler_ = std::move(f);
+        }
+
     private:
+        void wait_for_signal()
+        {
+            signals_.async_wait(
+              [this](const error_code& ec, int signal_number) {
+                  if (!ec && signal_handler_)
+                  {
+                      signal_handler_(signal_number);
+                      wait_for_signal();
+                      return;
+                  }
+                  stop();
+              });
+        }
+
+        /// Apply the configured name and CPU affinity to the calling thread (worker -1 is the acceptor thread)
+        void setup_current_thread(const std::string& suffix, int worker)
+        {
+#ifdef __linux__
+            if (!thread_name_prefix_.empty())
+            {
+                // Linux limits thread names to 15 characters
+                std::string name = (thread_name_prefix_ + "-" + suffix).substr(0, 15);
+                pthread_setname_np(pthread_self(), name.c_str());
+            }
+            if (worker >= 0 && !cpu_affinity_.empty())
+            {
+                int cpu = cpu_affinity_[worker % cpu_affinity_.size()];
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                if (rc != 0)
+                {
+                    CROW_LOG_WARNING << "Failed to pin worker " << worker << " to CPU " << cpu << ": error " << rc;
+                }
+                else
+                {
+                    CROW_LOG_INFO << "Worker " << worker << " pinned to CPU " << cpu;
+                }
+            }
+#else
+            (void)suffix;
+            (void)worker;
+#endif
+        }
+
+        /// Pick a worker for a new connection using power of two choices:
+        /// two random io_contexts are compared by load and the lighter one wins.
+        /// Comparing two random candidates instead of scanning for the global minimum
+        /// keeps a burst of accepts from piling onto the single least loaded context.
         size_t pick_io_context_idx()
         {
-            size_t min_queue_idx = 0;
+            std::lock_guard<std::mutex> lock(pick_mutex_);
 
-            // TODO improve load balancing
             // size_t is used here to avoid the security issue https://codeql.github.com/codeql-query-help/cpp/cpp-comparison-with-wider-type/
             // even though the max value of this can be only uint16_t as concurrency is uint16_t.
-            for (size_t i = 1; i < task_queue_length_pool_.size() && task_queue_length_pool_[min_queue_idx] > 0; i++)
-            // No need to check other io_services if the current one has no tasks
+            size_t count = task_queue_length_pool_.size();
+            if (count == 1)
+                return 0;
+
+            size_t first = pick_rng_() % count;
+            size_t second = pick_rng_() % (count - 1);
+            if (second >= first)
+                second++;
+            return io_context_load(second) < io_context_load(first) ? second : first;
+        }
+
+        /// Load of a worker: queued HTTP work, live websockets (they stay on the context until closed)
+        /// and incoming websocket messages, where 10 messages per second weigh as much as one connection.
+        double io_context_load(size_t idx)
+        {
+            auto& load = detail::io_context_load::of(*io_context_pool_[idx]);
+            return task_queue_length_pool_[idx] + load.websockets() + load.message_rate() / 10.0;
+        }
+
+        /// The socket new connections arrive on: the main acceptor, or the first worker acceptor
+        /// once the main one is handed over to it.
+        Acceptor& listener() { return worker_acceptors_.empty() ? acceptor_ : *worker_acceptors_.front(); }
+        const Acceptor& listener() const { return worker_acceptors_.empty() ? acceptor_ : *worker_acceptors_.front(); }
+
+        /// Let several sockets listen on one port; the kernel spreads new connections between them (Linux, TCP).
+        static bool set_reuse_port(Acceptor& acceptor)
+        {
+#if defined(__linux__) && defined(SO_REUSEPORT)
+            if constexpr (std::is_same<Acceptor, TCPAcceptor>::value)
+            {
+                int one = 1;
+                return ::setsockopt(acceptor.raw_acceptor().native_handle(), SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == 0;
+            }
+#endif
+            (void)acceptor;
+            return false;
+        }
+
+        /// Give every worker its own SO_REUSEPORT acceptor on the main acceptor's port, so connections
+        /// are balanced by the kernel and accepted on the thread that serves them.
+        /// Worker 0 takes over the main socket, which is then closed on the main thread.
+        bool open_worker_acceptors()
+        {
+            error_code ec;
+            auto endpoint = acceptor_.local_endpoint();
+            std::vector<std::unique_ptr<Acceptor>> acceptors;
+            for (size_t i = 0; i < io_context_pool_.size(); i++)
             {
-                if (task_queue_length_pool_[i] < task_queue_length_pool_[min_queue_idx])
-                    min_queue_idx = i;
+                auto acceptor = std::make_unique<Acceptor>(*io_context_pool_[i]);
+                if (i == 0)
+                {
+                    int fd = ::dup(acceptor_.raw_acceptor().native_handle());
+                    acceptor->raw_acceptor().assign(endpoint.protocol(), fd, ec);
+                    if (ec && fd >= 0)
+                        ::close(fd);
+                }
+                else
+                {
+                    acceptor->raw_acceptor().open(endpoint.protocol(), ec);
+                    if (!ec)
+                        acceptor->raw_acceptor().set_option(Acceptor::reuse_address_option(), ec);
+                    if (!ec && !set_reuse_port(*acceptor))
+                        ec = asio::error::operation_not_supported;
+                    if (!ec)
+                        acceptor->raw_acceptor().bind(endpoint, ec);
+                    if (!ec)
+                        acceptor->raw_acceptor().listen(tcp::acceptor::max_listen_connections, ec);
+                }
+                if (ec)
+                {
+                    CROW_LOG_ERROR << "Failed to open acceptor for worker " << i << ": " << ec.message();
+                    return false;
+                }
+                acceptors.push_back(std::move(acceptor));
             }
-            return min_queue_idx;
+
+            worker_acceptors_ = std::move(acceptors);
+            acceptor_.raw_acceptor().close(ec);
+            return true;
+        }
+
+        /// Accept loop of a worker acceptor; runs on the worker's own io_context.
+        void do_worker_accept(size_t context_idx)
+        {
+            if (shutting_down_)
+                return;
+
+            asio::io_context& ic = *io_context_pool_[context_idx];
+            auto p = std::make_shared<Connection<Adaptor, Handler, Middlewares...>>(
+              ic, handler_, server_name_, middlewares_,
+              get_cached_date_str_pool_[context_idx], *task_timer_pool_[context_idx], adaptor_ctx_, task_queue_length_pool_[context_idx]);
+
+            worker_acceptors_[context_idx]->raw_acceptor().async_accept(
+              p->socket(),
+              [this, p, context_idx](error_code ec) {
+                  if (ec == asio::error::operation_aborted)
+                      return;
+                  if (!ec)
+                  {
+                      detail::apply_socket_options(p->socket(), socket_options_);
+                      p->start();
+                  }
+                  do_worker_accept(context_idx);
+              });
         }
 
         void do_accept()
@@ -311,13 +566,15 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                     ic, handler_, server_name_, middlewares_,
                     get_cached_date_str_pool_[context_idx], *task_timer_pool_[context_idx], adaptor_ctx_, task_queue_length_pool_[context_idx]);
                     
-                CROW_LOG_DEBUG << &ic << " {" << context_idx << "} queue length: " << task_queue_length_pool_[context_idx];
+                CROW_LOG_DEBUG << &ic << " {" << context_idx << "} queue length: " << task_queue_length_pool_[context_idx]
+                               << ", websockets: " << detail::io_context_load::of(ic).websockets();
 
                 acceptor_.raw_acceptor().async_accept(
                   p->socket(),
                   [this, p, &ic](error_code ec) {
                       if (!ec)
                       {
+                          detail::apply_socket_options(p->socket(), socket_options_);
                           asio::post(ic,
                             [p] {
                                 p->start();
@@ -344,7 +601,8 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         std::vector<detail::task_timer*> task_timer_pool_;
         std::vector<std::function<std::string()>> get_cached_date_str_pool_;
         Acceptor acceptor_;
-        bool shutting_down_ = false;
+        std::vector<std::unique_ptr<Acceptor>> worker_acceptors_;
+        std::atomic<bool> shutting_down_{false};
         bool server_started_{false};
         bool startup_failed_ = false;
         std::condition_variable cv_started_;
@@ -360,9 +618,18 @@ namespace crow // NOTE: Already documented in "crow/app.h"
 
         std::chrono::milliseconds tick_interval_;
         std::function<void()> tick_function_;
+        std::function<void(int)> signal_handler_;
+
+        std::vector<int> cpu_affinity_;
+        std::string thread_name_prefix_;
+        socket_options socket_options_;
+
+        std::mutex pick_mutex_;
+        std::minstd_rand pick_rng_{std::random_device{}()};
 
         std::tuple<Middlewares...>* middlewares_;
 
+        bool reuse_port_;
         typename Adaptor::context* adaptor_ctx_;
     };
 } // namespace crow
@@ -0,0 +1,99 @@
+#pragma once
+
+#ifdef CROW_USE_BOOST
+#include <boost/asio.hpp>
+#else
+#ifndef ASIO_STANDALONE
+#define ASIO_STANDALONE
+#endif
+#include <asio.hpp>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace crow
+{
+#ifdef CROW_USE_BOOST
+    namespace asio = boost::asio;
+#endif
+    namespace detail
+    {
+
+        /// Load counters attached to an io_context as an asio service.
+        ///
+        /// Websocket connections stay on the io_context they were accepted on
+        /// for their whole lifetime, so the server needs to know how many of them
+        /// live on each context and how busy they are to place new connections.
+        /// Any code holding the io_context can reach the counters through
+        /// `asio::use_service<io_context_load>(ctx)` without extra plumbing.
+        ///
+        /// The traffic counters are written only by the thread running the context
+        /// and summed over all contexts when they are read (e.g. by a metrics scrape),
+        /// so connections never contend on them.
+        class io_context_load : public asio::execution_context::service
+        {
+        public:
+            static inline asio::execution_context::id id;
+
+            explicit io_context_load(asio::execution_context& ctx):
+              asio::execution_context::service(ctx)
+            {}
+
+            static io_context_load& of(asio::io_context& ctx)
+            {
+                return asio::use_service<io_context_load>(ctx);
+            }
+
+            void websocket_opened() { websockets_.fetch_add(1, std::memory_order_relaxed); }
+            void websocket_closed() { websockets_.fetch_sub(1, std::memory_order_relaxed); }
+            void message_received() { messages_.fetch_add(1, std::memory_order_relaxed); }
+            void bytes_received(uint64_t n) { bytes_received_.fetch_add(n, std::memory_order_relaxed); }
+            void bytes_sent(uint64_t n) { bytes_sent_.fetch_add(n, std::memory_order_relaxed); }
+            void frame_queued(uint64_t size) { queued_bytes_.fetch_add(size, std::memory_order_relaxed); }
+            void frame_dequeued(uint64_t size) { queued_bytes_.fetch_sub(size, std::memory_order_relaxed); }
+
+            uint32_t websockets() const { return websockets_.load(std::memory_order_relaxed); }
+            uint64_t messages() const { return messages_.load(std::memory_order_relaxed); }
+            /// Websocket payload bytes read from the peers
+            uint64_t bytes_received() const { return bytes_received_.load(std::memory_order_relaxed); }
+            /// Bytes written to the sockets, frame headers included
+            uint64_t bytes_sent() const { return bytes_sent_.load(std::memory_order_relaxed); }
+            /// Bytes waiting in the send queues of the websockets on this context
+            uint64_t queued_bytes() const { return queued_bytes_.load(std::memory_order_relaxed); }
+
+            /// Messages per second, averaged over the last sampling window.
+            /// The sampling window is not synchronized, callers serialize access.
+            double message_rate()
+            {
+                auto now = std::chrono::steady_clock::now();
+                auto elapsed = std::chrono::duration<double>(now - sampled_at_).count();
+                if (elapsed >= 1.0)
+                {
+                    uint64_t messages = messages_.load(std::memory_order_relaxed);
+                    double rate = (messages - sampled_messages_) / elapsed;
+                    // Smooth so a single burst does not steer every following accept
+                    rate_ = sampled_messages_ == 0 && rate_ == 0 ? rate : rate_ * 0.5 + rate * 0.5;
+                    sampled_messages_ = messages;
+                    sampled_at_ = now;
+                }
+                return rate_;
+            }
+
+        private:
+            void shutdown() override {}
+
+            std::atomic<uint32_t> websockets_{0};
+            std::atomic<uint64_t> messages_{0};
+            std::atomic<uint64_t> bytes_received_{0};
+            std::atomic<uint64_t> bytes_sent_{0};
+            std::atomic<uint64_t> queued_bytes_{0};
+
+            std::chrono::steady_clock::time_point sampled_at_{std::chrono::steady_clock::now()};
+            uint64_t sampled_messages_{0};
+            double rate_{0};
+        };
+
+    } // namespace detail
+} // namespace crow
@@ -1270,6 +1270,15 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             return ret;
         }
 
+        /// Parse `data` in place, without copying it.
+        ///
+        /// The parser overwrites quotes in `data` and the returned value points into it,
+        /// so `data` must outlive the result and is not valid JSON afterwards.
+        inline rvalue load_inplace(std::string& data)
+        {
+            return load_nocopy_internal(&data[0], data.size());
+        }
+
         inline rvalue load(const char* data)
         {
             return load(data, strlen(data));
@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -107,17 +108,42 @@ namespace crow
     public:
         logger(LogLevel level):
           level_(level)
-        {}
+        {
+            // Reuse the thread's stream: constructing one per line touches the process-wide locale,
+            // which io threads logging at the same time contend on. A line logged while building
+            // another one (from an operator<<) gets its own stream.
+            auto& cached = thread_stream();
+            if (!cached.in_use)
+            {
+                cached.in_use = true;
+                cached.stream.str(std::string());
+                cached.stream.clear();
+                cached.stream.flags(std::ios_base::skipws | std::ios_base::dec);
+                cached.stream.precision(6);
+                cached.stream.fill(' ');
+                stream_ = &cached.stream;
+            }
+            else
+            {
+                own_stream_.reset(new std::ostringstream);
+                stream_ = own_stream_.get();
+            }
+        }
         ~logger()
         {
 #ifdef CROW_ENABLE_LOGGING
             if (level_ >= get_current_log_level())
             {
-                get_handler_ref()->log(stringstream_.str(), level_);
+                get_handler_ref()->log(stream_->str(), level_);
             }
 #endif
+            if (!own_stream_)
+                thread_stream().in_use = false;
         }
 
+        logger(const logger&) = delete;
+        logger& operator=(const logger&) = delete;
+
         //
         template<typename T>
         logger& operator<<(T const& value)
@@ -125,7 +151,7 @@ namespace crow
 #ifdef CROW_ENABLE_LOGGING
             if (level_ >= get_current_log_level())
             {
-                stringstream_ << value;
+                *stream_ << value;
             }
 #endif
             return *this;
@@ -134,7 +160,10 @@ namespace crow
         //
         static void setLogLevel(LogLevel level) { get_log_level_ref() = level; }
 
-        static void setHandler(ILogHandler* handler) { get_handler_ref() = handler; }
+        /// Install a log handler; nullptr restores the default one (stderr).
+        static void setHandler(ILogHandler* handler) { get_handler_ref() = handler ? handler : default_handler(); }
+
+        static ILogHandler* getHandler() { return get_handler_ref(); }
 
         static LogLevel get_current_log_level() { return get_log_level_ref(); }
 
@@ -145,31 +174,47 @@ namespace crow
             static LogLevel current_level = static_cast<LogLevel>(CROW_LOG_LEVEL);
             return current_level;
         }
+        static ILogHandler* default_handler()
+        {
+            static CerrLogHandler handler;
+            return &handler;
+        }
         static ILogHandler*& get_handler_ref()
         {
-            static CerrLogHandler default_handler;
-            static ILogHandler* current_handler = &default_handler;
+            static ILogHandler* current_handler = default_handler();
             return current_handler;
         }
 
+        struct cached_stream
+        {
+            std::ostringstream stream;
+            bool in_use{false};
+        };
+        static cached_stream& thread_stream()
+        {
+            static thread_local cached_stream cached;
+            return cached;
+        }
+
         //
-        std::ostringstream stringstream_;
+        std::ostringstream* stream_;
+        std::unique_ptr<std::ostringstream> own_stream_;
         LogLevel level_;
     };
 } // namespace crow
 
-#define CROW_LOG_CRITICAL                                                  \
-    if (crow::logger::get_current_log_level() <= crow::LogLevel::Critical) \
+#define CROW_LOG_CRITICAL                                                                                  \
+    if (CROW_LOG_COMPILED_LEVEL <= 4 && crow::logger::get_current_log_level() <= crow::LogLevel::Critical) \
     crow::logger(crow::LogLevel::Critical)
-#define CROW_LOG_ERROR                                                  \
-    if (crow::logger::get_current_log_level() <= crow::LogLevel::Error) \
+#define CROW_LOG_ERROR                                                                                     \
+    if (CROW_LOG_COMPILED_LEVEL <= 3 && crow::logger::get_current_log_level() <= crow::LogLevel::Error)    \
     crow::logger(crow::LogLevel::Error)
-#define CROW_LOG_WARNING                                                  \
-    if (crow::logger::get_current_log_level() <= crow::LogLevel::Warning) \
+#define CROW_LOG_WARNING                                                                                   \
+    if (CROW_LOG_COMPILED_LEVEL <= 2 && crow::logger::get_current_log_level() <= crow::LogLevel::Warning)  \
     crow::logger(crow::LogLevel::Warning)
-#define CROW_LOG_INFO                                                  \
-    if (crow::logger::get_current_log_level() <= crow::LogLevel::Info) \
+#define CROW_LOG_INFO                                                                                      \
+    if (CROW_LOG_COMPILED_LEVEL <= 1 && crow::logger::get_current_log_level() <= crow::LogLevel::Info)     \
     crow::logger(crow::LogLevel::Info)
-#define CROW_LOG_DEBUG                                                  \
-    if (crow::logger::get_current_log_level() <= crow::LogLevel::Debug) \
+#define CROW_LOG_DEBUG                                                                                     \
+    if (CROW_LOG_COMPILED_LEVEL <= 0 && crow::logger::get_current_log_level() <= crow::LogLevel::Debug)    \
     crow::logger(crow::LogLevel::Debug)
@@ -461,6 +461,40 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         }
 #endif
 
+#ifndef _WIN32
+        /// Take over an upgraded websocket connection from another process (hot restart)
+        void adopt(int native_handle, asio::io_context& io_context,
+                   std::function<void(crow::websocket::connection&)> adopted_handler)
+        {
+            max_payload_ = max_payload_override_ ? max_payload_ : app_->websocket_max_payload();
+
+            sockaddr_storage address{};
+            socklen_t length = sizeof(address);
+            getsockname(native_handle, reinterpret_cast<sockaddr*>(&address), &length);
+
+            error_code ec;
+            if (address.ss_family == AF_UNIX)
+            {
+                UnixSocketAdaptor adaptor(io_context, nullptr);
+                adaptor.raw_socket().assign(stream_protocol(), native_handle, ec);
+                if (!ec)
+                    crow::websocket::Connection<UnixSocketAdaptor, App>::adopt(std::move(adaptor), app_, max_payload_, open_handler_, message_handler_, close_handler_, error_handler_, std::move(adopted_handler));
+            }
+            else
+            {
+                SocketAdaptor adaptor(io_context, nullptr);
+                adaptor.raw_socket().assign(address.ss_family == AF_INET6 ? tcp::v6() : tcp::v4(), native_handle, ec);
+                if (!ec)
+                    crow::websocket::Connection<SocketAdaptor, App>::adopt(std::move(adaptor), app_, max_payload_, open_handler_, message_handler_, close_handler_, error_handler_, std::move(adopted_handler));
+            }
+            if (ec)
+            {
+                CROW_LOG_ERROR << "Failed to adopt websocket: " << ec.message();
+                ::close(native_handle);
+            }
+        }
+#endif
+
         /// Override the global payload limit for this single WebSocket rule
         self_t& max_payload(uint64_t max_payload)
         {
@@ -530,7 +564,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
     protected:
         App* app_;
         std::function<void(crow::websocket::connection&)> open_handler_;
-        std::function<void(crow::websocket::connection&, const std::string&, bool)> message_handler_;
+        crow::websocket::message_handler_type message_handler_;
         std::function<void(crow::websocket::connection&, const std::string&, uint16_t)> close_handler_;
         std::function<void(crow::websocket::connection&, const std::string&)> error_handler_;
         std::function<void(const crow::request&, std::optional<crow::response>&, void**)> accept_handler_;
@@ -25,6 +25,14 @@
 #define CROW_LOG_LEVEL 1
 #endif
 
+/* #define - specifies the lowest log level compiled in (same values as CROW_LOG_LEVEL)
+    CROW_LOG_* statements below it are removed by the compiler, arguments included,
+    and cannot be enabled at runtime. Defaults to Debug (everything compiled in).
+*/
+#ifndef CROW_LOG_COMPILED_LEVEL
+#define CROW_LOG_COMPILED_LEVEL 0
+#endif
+
 #ifndef CROW_STATIC_DIRECTORY
 #define CROW_STATIC_DIRECTORY "static/"
 #endif
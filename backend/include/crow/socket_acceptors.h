@@ -16,6 +16,10 @@
 
 #include "crow/logging.h"
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 namespace crow
 {
 #ifdef CROW_USE_BOOST
@@ -56,6 +60,7 @@ namespace crow
             return acceptor_.local_endpoint();
         }
         inline static tcp::acceptor::reuse_address reuse_address_option() { return tcp::acceptor::reuse_address(true); }
+        static void prepare_bind(const endpoint&) {}
     };
 
     struct UnixSocketAcceptor
@@ -90,5 +95,11 @@ namespace crow
             // reuse addr must be false (https://github.com/chriskohlhoff/asio/issues/622)
             return stream_protocol::acceptor::reuse_address(false);
         }
+        /// Remove the socket file left by a previous run, otherwise bind fails with "address in use".
+        /// A running server hands its listener over on hot restart instead of having the path rebound.
+        static void prepare_bind(const endpoint& ep)
+        {
+            ::unlink(ep.path().c_str());
+        }
     };
 } // namespace crow
@@ -35,6 +35,25 @@ namespace crow
     using tcp = asio::ip::tcp;
     using stream_protocol = asio::local::stream_protocol;
 
+    /// Name of the event demultiplexer asio was configured with, for logs.
+    ///
+    /// io_uring is used when the build defines ASIO_HAS_IO_URING and ASIO_DISABLE_EPOLL
+    /// (BOOST_ASIO_... with CROW_USE_BOOST) and links liburing.
+    inline const char* io_backend_name()
+    {
+#if defined(ASIO_HAS_IO_URING_AS_DEFAULT) || defined(BOOST_ASIO_HAS_IO_URING_AS_DEFAULT)
+        return "io_uring";
+#elif defined(ASIO_HAS_EPOLL) || defined(BOOST_ASIO_HAS_EPOLL)
+        return "epoll";
+#elif defined(ASIO_HAS_KQUEUE) || defined(BOOST_ASIO_HAS_KQUEUE)
+        return "kqueue";
+#elif defined(ASIO_HAS_IOCP) || defined(BOOST_ASIO_HAS_IOCP)
+        return "iocp";
+#else
+        return "select";
+#endif
+    }
+
     /// A wrapper for the asio::ip::tcp::socket and asio::ssl::stream
     struct SocketAdaptor
     {
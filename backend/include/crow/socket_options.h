@@ -0,0 +1,120 @@
+#pragma once
+
+#ifdef CROW_USE_BOOST
+#include <boost/asio.hpp>
+#else
+#ifndef ASIO_STANDALONE
+#define ASIO_STANDALONE
+#endif
+#include <asio.hpp>
+#endif
+
+#include <type_traits>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+#include "crow/logging.h"
+
+namespace crow
+{
+#ifdef CROW_USE_BOOST
+    namespace asio = boost::asio;
+    using error_code = boost::system::error_code;
+#else
+    using error_code = asio::error_code;
+#endif
+
+    /// TCP options set on every accepted connection of a listener. Zero or false leaves the system default.
+    ///
+    /// Options other than no_delay, the buffer sizes and keepalive itself are Linux only and ignored elsewhere.
+    /// Unix domain socket listeners ignore all of them.
+    struct socket_options
+    {
+        bool no_delay{false};             ///< TCP_NODELAY: send small messages at once instead of waiting for an ACK (Nagle)
+        bool quick_ack{false};            ///< TCP_QUICKACK: ACK right away; the kernel drops it, so websockets re-arm it after each read
+        int busy_poll_us{0};              ///< SO_BUSY_POLL: spin on the device queue for this long on a blocking read
+        int send_buffer{0};               ///< SO_SNDBUF in bytes
+        int receive_buffer{0};            ///< SO_RCVBUF in bytes
+        unsigned user_timeout_ms{0};      ///< TCP_USER_TIMEOUT: drop the connection when sent data stays unacknowledged this long
+        unsigned keepalive_idle_s{0};     ///< SO_KEEPALIVE with TCP_KEEPIDLE; 0 - no keepalive
+        unsigned keepalive_interval_s{0}; ///< TCP_KEEPINTVL
+        unsigned keepalive_count{0};      ///< TCP_KEEPCNT
+    };
+
+    namespace detail
+    {
+#ifdef __linux__
+        template<typename Socket>
+        void set_int_option(Socket& socket, int level, int name, int value, const char* option_name)
+        {
+            if (::setsockopt(socket.native_handle(), level, name, &value, sizeof(value)) != 0)
+            {
+                CROW_LOG_WARNING << "Cannot set " << option_name << " on accepted socket";
+            }
+        }
+#endif
+
+        /// Re-enable TCP_QUICKACK, which the kernel clears again after a few segments.
+        template<typename Socket>
+        void rearm_quick_ack(Socket& socket)
+        {
+#ifdef __linux__
+            if constexpr (std::is_same<typename Socket::protocol_type, asio::ip::tcp>::value)
+            {
+                int one = 1;
+                ::setsockopt(socket.native_handle(), IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+            }
+#else
+            (void)socket;
+#endif
+        }
+
+        /// Apply the listener's options to a freshly accepted socket.
+        template<typename Socket>
+        void apply_socket_options(Socket& socket, const socket_options& options)
+        {
+            if constexpr (std::is_same<typename Socket::protocol_type, asio::ip::tcp>::value)
+            {
+                error_code ec;
+                if (options.no_delay)
+                    socket.set_option(asio::ip::tcp::no_delay(true), ec);
+                if (options.send_buffer > 0)
+                    socket.set_option(asio::socket_base::send_buffer_size(options.send_buffer), ec);
+                if (options.receive_buffer > 0)
+                    socket.set_option(asio::socket_base::receive_buffer_size(options.receive_buffer), ec);
+                if (options.keepalive_idle_s > 0)
+                    socket.set_option(asio::socket_base::keep_alive(true), ec);
+                if (ec)
+                {
+                    CROW_LOG_WARNING << "Cannot set socket options on accepted socket: " << ec.message();
+                }
+
+#ifdef __linux__
+                if (options.quick_ack)
+                    set_int_option(socket, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+                if (options.busy_poll_us > 0)
+                    set_int_option(socket, SOL_SOCKET, SO_BUSY_POLL, options.busy_poll_us, "SO_BUSY_POLL");
+                if (options.user_timeout_ms > 0)
+                    set_int_option(socket, IPPROTO_TCP, TCP_USER_TIMEOUT, static_cast<int>(options.user_timeout_ms), "TCP_USER_TIMEOUT");
+                if (options.keepalive_idle_s > 0)
+                {
+                    set_int_option(socket, IPPROTO_TCP, TCP_KEEPIDLE, static_cast<int>(options.keepalive_idle_s), "TCP_KEEPIDLE");
+                    if (options.keepalive_interval_s > 0)
+                        set_int_option(socket, IPPROTO_TCP, TCP_KEEPINTVL, static_cast<int>(options.keepalive_interval_s), "TCP_KEEPINTVL");
+                    if (options.keepalive_count > 0)
+                        set_int_option(socket, IPPROTO_TCP, TCP_KEEPCNT, static_cast<int>(options.keepalive_count), "TCP_KEEPCNT");
+                }
+#endif
+            }
+            else
+            {
+                (void)socket;
+                (void)options;
+            }
+        }
+    } // namespace detail
+} // namespace crow
@@ -0,0 +1,143 @@
+#pragma once
+
+#ifdef CROW_USE_BOOST
+#include <boost/asio.hpp>
+#else
+#ifndef ASIO_STANDALONE
+#define ASIO_STANDALONE
+#endif
+#include <asio.hpp>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace crow
+{
+#ifdef CROW_USE_BOOST
+    namespace asio = boost::asio;
+    using error_code = boost::system::error_code;
+#else
+    using error_code = asio::error_code;
+#endif
+    namespace detail
+    {
+
+        /// Hashed timer wheel attached to an io_context as an asio service.
+        ///
+        /// Meant for many long, coarse, mostly identical timeouts (e.g. one heartbeat per websocket),
+        /// where a steady_timer per connection would cost a heap entry in the reactor each.
+        /// Scheduling and firing are O(1); a single steady_timer per io_context ticks only while tasks are pending.
+        ///
+        /// Not thread safe: use it only from the thread running the io_context, as connections do.
+        /// Tasks cannot be cancelled, they should hold a weak reference to their owner and check it.
+        class timer_wheel : public asio::execution_context::service
+        {
+        public:
+            using task_type = std::function<void()>;
+            using clock_type = std::chrono::steady_clock;
+
+            static constexpr std::chrono::milliseconds tick_length{250};
+            static constexpr size_t slot_count = 256; // One turn of the wheel is 64 seconds
+
+            static inline asio::execution_context::id id;
+
+            explicit timer_wheel(asio::execution_context& ctx):
+              asio::execution_context::service(ctx),
+              timer_(static_cast<asio::io_context&>(ctx))
+            {}
+
+            static timer_wheel& of(asio::io_context& ctx)
+            {
+                return asio::use_service<timer_wheel>(ctx);
+            }
+
+            /// Run `task` once after `delay`, rounded up to the tick length.
+            void schedule(std::chrono::milliseconds delay, task_type task)
+            {
+                if (pending_ == 0)
+                {
+                    // The wheel was stopped: continue from the current time instead of catching up
+                    started_at_ = clock_type::now();
+                    ticks_ = 0;
+                }
+
+                uint64_t ticks = std::max<int64_t>(1, (delay + tick_length - std::chrono::milliseconds(1)) / tick_length);
+                auto& slot = slots_[(cursor_ + ticks) % slot_count];
+                slot.push_back({(ticks - 1) / slot_count, std::move(task)});
+                if (pending_++ == 0 && !in_tick_)
+                    arm();
+            }
+
+            size_t pending() const { return pending_; }
+
+        private:
+            struct entry
+            {
+                uint64_t rounds; // Full turns of the wheel left before the task is due
+                task_type task;
+            };
+
+            void arm()
+            {
+                // Ticks are counted from the start, so slow handlers do not make the wheel drift
+                timer_.expires_at(started_at_ + (ticks_ + 1) * tick_length);
+                timer_.async_wait([this](const error_code& ec) {
+                    if (ec)
+                        return;
+                    tick();
+                });
+            }
+
+            void tick()
+            {
+                ++ticks_;
+                cursor_ = (cursor_ + 1) % slot_count;
+
+                // Tasks may schedule again, possibly into this very slot: run them from a separate list
+                std::vector<entry> due, waiting;
+                for (auto& e : slots_[cursor_])
+                {
+                    if (e.rounds == 0)
+                        due.push_back(std::move(e));
+                    else
+                    {
+                        --e.rounds;
+                        waiting.push_back(std::move(e));
+                    }
+                }
+                slots_[cursor_].swap(waiting);
+
+                pending_ -= due.size();
+                in_tick_ = true;
+                for (auto& e : due)
+                    e.task();
+                in_tick_ = false;
+
+                if (pending_ != 0)
+                    arm();
+            }
+
+            void shutdown() override
+            {
+                timer_.cancel();
+                for (auto& slot : slots_)
+                    slot.clear();
+                pending_ = 0;
+            }
+
+            asio::steady_timer timer_;
+            std::array<std::vector<entry>, slot_count> slots_;
+            size_t cursor_{0};
+            size_t pending_{0};
+            clock_type::time_point started_at_;
+            uint64_t ticks_{0};
+            bool in_tick_{false};
+        };
+
+    } // namespace detail
+} // namespace crow
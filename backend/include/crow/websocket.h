@@ -1,15 +1,30 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <memory>
 #include <optional>
 #include <string>
 #include <thread>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include "crow/http_response.h"
 #include "crow/logging.h"
 #include "crow/socket_adaptors.h"
 #include "crow/http_request.h"
 #include "crow/TinySHA1.hpp"
 #include "crow/utility.h"
+#include "crow/io_context_load.h"
+#include "crow/timer_wheel.h"
+#include "crow/socket_options.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace crow // NOTE: Already documented in "crow/app.h"
 {
@@ -62,6 +77,213 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             EndStatusCodes = 4999,
         };
 
+        namespace detail
+        {
+            /// XOR a masked payload with the 4 byte key, in place.
+            ///
+            /// `mask` holds the key bytes in wire order, so replicating it over wider registers keeps
+            /// every lane in phase with the payload. Wide blocks go through AVX2/SSE2 when the compiler
+            /// targets them, then 64-bit words, then a scalar tail. Every block is a multiple of 4 bytes,
+            /// so the tail starts at key byte 0.
+            inline void unmask(char* data, size_t size, uint32_t mask)
+            {
+                size_t i = 0;
+#if defined(__AVX2__)
+                const __m256i mask256 = _mm256_set1_epi32(static_cast<int>(mask));
+                for (; i + 32 <= size; i += 32)
+                {
+                    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(block, mask256));
+                }
+#endif
+#if defined(__SSE2__)
+                const __m128i mask128 = _mm_set1_epi32(static_cast<int>(mask));
+                for (; i + 16 <= size; i += 16)
+                {
+                    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(block, mask128));
+                }
+#endif
+                const uint64_t mask64 = (static_cast<uint64_t>(mask) << 32) | mask;
+                for (; i + 8 <= size; i += 8)
+                {
+                    uint64_t word;
+                    std::memcpy(&word, data + i, 8);
+                    word ^= mask64;
+                    std::memcpy(data + i, &word, 8);
+                }
+                const char* key = reinterpret_cast<const char*>(&mask);
+                for (; i < size; i++)
+                {
+                    data[i] ^= key[i & 3];
+                }
+            }
+
+            /// Write the header of a final frame with the opcode and payload size (in bytes) into `buf`,
+            /// which must hold 10 bytes. Returns the header length.
+            inline uint8_t encode_frame_header(char* buf, int opcode, size_t size)
+            {
+                buf[0] = static_cast<char>(0x80 + opcode);
+                buf[1] = 0;
+                if (size < 126)
+                {
+                    buf[1] += static_cast<char>(size);
+                    return 2;
+                }
+                else if (size < 0x10000)
+                {
+                    buf[1] += 126;
+                    *(uint16_t*)(buf + 2) = htons(static_cast<uint16_t>(size));
+                    return 4;
+                }
+                else
+                {
+                    buf[1] += 127;
+                    *reinterpret_cast<uint64_t*>(buf + 2) = ((1 == htonl(1)) ? static_cast<uint64_t>(size) : (static_cast<uint64_t>(htonl((size)&0xFFFFFFFF)) << 32) | htonl(static_cast<uint64_t>(size) >> 32));
+                    return 10;
+                }
+            }
+
+            /// Token bucket refilled at `rate` tokens per second up to `burst`; starts full.
+            struct token_bucket
+            {
+                double tokens{-1};
+                std::chrono::steady_clock::time_point updated;
+
+                bool take(double rate, double burst)
+                {
+                    auto now = std::chrono::steady_clock::now();
+                    burst = std::max(burst, 1.0);
+                    if (tokens < 0)
+                        tokens = burst;
+                    else
+                        tokens = std::min(burst, tokens + rate * std::chrono::duration<double>(now - updated).count());
+                    updated = now;
+                    if (tokens < 1)
+                        return false;
+                    tokens -= 1;
+                    return true;
+                }
+            };
+        } // namespace detail
+
+        /// An immutable text or binary message with its frame header built once.
+        ///
+        /// The same message can be queued on any number of connections, and kept for resending,
+        /// without copying the payload: connections hold a reference until it is written.
+        class shared_message
+        {
+        public:
+            /// A message with a non-zero `conflation_key` replaces a not yet written message with the same key
+            /// in a connection's queue, for data where only the latest value matters.
+            static std::shared_ptr<const shared_message> text(std::string payload, uint32_t conflation_key = 0)
+            {
+                return std::make_shared<const shared_message>(0x1, std::move(payload), conflation_key);
+            }
+
+            static std::shared_ptr<const shared_message> binary(std::string payload, uint32_t conflation_key = 0)
+            {
+                return std::make_shared<const shared_message>(0x2, std::move(payload), conflation_key);
+            }
+
+            shared_message(int opcode, std::string payload, uint32_t conflation_key = 0):
+              payload_(std::move(payload)),
+              header_size_(detail::encode_frame_header(header_.data(), opcode, payload_.size())),
+              is_binary_(opcode == 0x2),
+              conflation_key_(conflation_key)
+            {}
+
+            const std::string& payload() const { return payload_; }
+            bool is_binary() const { return is_binary_; }
+            const char* header() const { return header_.data(); }
+            size_t header_size() const { return header_size_; }
+            uint32_t conflation_key() const { return conflation_key_; }
+
+        private:
+            std::string payload_;
+            std::array<char, 2 + 8> header_;
+            uint8_t header_size_;
+            bool is_binary_;
+            uint32_t conflation_key_;
+        };
+
+        using shared_message_ptr = std::shared_ptr<const shared_message>;
+
+        /// Limits of the outgoing queue of a connection (0 - unlimited).
+        /// A peer that does not read fast enough to stay under them is disconnected with PolicyViolated.
+        struct send_queue_limits
+        {
+            uint64_t max_bytes{0};
+            size_t max_messages{0};
+        };
+
+        /// Process-wide counters of outgoing queue handling, for monitoring.
+        struct send_queue_stats
+        {
+            std::atomic<uint64_t> conflated{0}; ///< Queued messages replaced by a newer one with the same conflation key
+            std::atomic<uint64_t> evicted{0};   ///< Connections closed for exceeding the send queue limits
+        };
+
+        inline send_queue_stats& global_send_queue_stats()
+        {
+            static send_queue_stats stats;
+            return stats;
+        }
+
+        /// Server side pings. A connection from which nothing, not even a pong, arrives
+        /// through `max_missed` pings in a row is closed as dead.
+        struct heartbeat_settings
+        {
+            std::chrono::milliseconds interval{0}; ///< 0 - no pings
+            uint32_t max_missed{3};
+        };
+
+        /// Process-wide heartbeat counters, for monitoring.
+        struct heartbeat_stats
+        {
+            std::atomic<uint64_t> pongs{0};      ///< Pongs answering the server's pings
+            std::atomic<uint64_t> latency_us{0}; ///< Sum of their round trip times, in microseconds
+            std::atomic<uint64_t> timed_out{0};  ///< Connections closed for missing pongs
+        };
+
+        inline heartbeat_stats& global_heartbeat_stats()
+        {
+            static heartbeat_stats stats;
+            return stats;
+        }
+
+        /// Incoming message rate limit of a connection, checked before the message handler runs.
+        /// Messages over the limit are dropped; after `max_dropped` drops in a row the connection is closed.
+        struct message_rate_limit
+        {
+            double rate{0};  ///< Messages per second, 0 - unlimited
+            double burst{0}; ///< Messages allowed at once after a quiet period
+            uint32_t max_dropped{0}; ///< 0 - never close, only drop
+        };
+
+        /// Process-wide counters of incoming message limits, for monitoring.
+        struct message_limit_stats
+        {
+            std::atomic<uint64_t> dropped{0};      ///< Messages over the rate limit
+            std::atomic<uint64_t> disconnected{0}; ///< Connections closed for flooding
+            std::atomic<uint64_t> oversized{0};    ///< Connections closed for a message over max_payload
+        };
+
+        inline message_limit_stats& global_message_limit_stats()
+        {
+            static message_limit_stats stats;
+            return stats;
+        }
+
+        struct connection;
+
+        /// Message handler signature.
+        ///
+        /// The payload is the connection's own receive buffer: it is valid only during the call and is reused
+        /// for the next message, so handlers taking it as `std::string&` may modify it in place
+        /// (e.g. parse it with `crow::json::load_inplace`). Handlers taking `const std::string&` fit as well.
+        using message_handler_type = std::function<void(connection&, std::string&, bool)>;
+
         /// A base class for websocket connection.
         struct connection
         {
@@ -71,9 +293,27 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             virtual void send_pong(std::string msg) = 0;
             virtual void close(std::string const& msg = "quit", uint16_t status_code = CloseStatusCode::NormalClosure) = 0;
             virtual std::string get_remote_ip() = 0;
+
+            /// Send a shared message. Connections that cannot queue it as is send a copy of the payload.
+            virtual void send(shared_message_ptr msg)
+            {
+                if (msg->is_binary())
+                    send_binary(msg->payload());
+                else
+                    send_text(msg->payload());
+            }
             virtual std::string get_subprotocol() const = 0;
             virtual ~connection() = default;
 
+            /// Round trip time of the last answered server ping, zero until the first pong.
+            virtual std::chrono::microseconds pong_latency() const { return {}; }
+
+            /// Give the connection away to another process (hot restart).
+
+            ///
+            /// `done` receives a duplicate of the socket descriptor, or -1 if the connection cannot be handed off.
+            virtual void handoff(std::function<void(int)> done) { done(-1); }
+
             void userdata(void* u) { userdata_ = u; }
             void* userdata() { return userdata_; }
 
@@ -117,7 +357,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             static void create(const crow::request& req, Adaptor adaptor, Handler* handler,
                                uint64_t max_payload, const std::vector<std::string>& subprotocols,
                                std::function<void(crow::websocket::connection&)> open_handler,
-                               std::function<void(crow::websocket::connection&, const std::string&, bool)> message_handler,
+                               message_handler_type message_handler,
                                std::function<void(crow::websocket::connection&, const std::string&, uint16_t)> close_handler,
                                std::function<void(crow::websocket::connection&, const std::string&)> error_handler,
                                std::function<void(const crow::request&, std::optional<crow::response>&, void**)> accept_handler,
@@ -186,7 +426,38 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 conn->start(crow::utility::base64encode((unsigned char*)digest, 20));
             }
 
-            ~Connection() noexcept override = default;
+            /// Factory for a connection taken over from another process (hot restart).
+            ///
+            /// The socket is already upgraded, so the handshake is skipped and reading starts right away.
+            /// `adopted_handler` is called before the first message is read.
+            static void adopt(Adaptor adaptor, Handler* handler, uint64_t max_payload,
+                              std::function<void(crow::websocket::connection&)> open_handler,
+                              message_handler_type message_handler,
+                              std::function<void(crow::websocket::connection&, const std::string&, uint16_t)> close_handler,
+                              std::function<void(crow::websocket::connection&, const std::string&)> error_handler,
+                              std::function<void(crow::websocket::connection&)> adopted_handler)
+            {
+                auto conn = std::shared_ptr<Connection>(new Connection(std::move(adaptor),
+                                                                       handler, max_payload,
+                                                                       std::move(open_handler),
+                                                                       std::move(message_handler),
+                                                                       std::move(close_handler),
+                                                                       std::move(error_handler),
+                                                                       nullptr));
+                conn->handler_->add_websocket(conn);
+                if (adopted_handler)
+                    adopted_handler(*conn);
+                conn->dispatch([conn]() {
+                    conn->schedule_heartbeat();
+                    conn->do_read();
+                });
+            }
+
+            ~Connection() noexcept override
+            {
+                load_.frame_dequeued(queued_bytes_);
+                load_.websocket_closed();
+            }
 
             template<typename Callable>
             struct WeakWrappedMessage
@@ -251,6 +522,16 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 send_data(0x1, std::move(msg));
             }
 
+            /// Queue a shared message; its payload and header are written from the shared buffer.
+            void send(shared_message_ptr msg) override
+            {
+                post([this, msg = std::move(msg)]() mutable {
+                    outgoing_frame frame;
+                    frame.shared = std::move(msg);
+                    queue_frame(std::move(frame));
+                });
+            }
+
             /// Send a close signal.
 
             ///
@@ -265,13 +546,14 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                         if (shared_this->close_handler_)
                             shared_this->close_handler_(*shared_this, msg, status_code);
                     }
-                    auto header = shared_this->build_header(0x8, msg.size() + 2);
                     char status_buf[2];
                     *(uint16_t*)(status_buf) = htons(status_code);
+                    std::string payload(status_buf, 2);
+                    payload += msg;
 
-                    shared_this->write_buffers_.emplace_back(std::move(header));
-                    shared_this->write_buffers_.emplace_back(std::string(status_buf, 2));
-                    shared_this->write_buffers_.emplace_back(msg);
+                    auto frame = make_frame(0x8, std::move(payload));
+                    shared_this->count_queued(frame.size());
+                    shared_this->write_buffers_.push_back(std::move(frame));
                     shared_this->do_write();
                 });
             }
@@ -292,29 +574,54 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 return subprotocol_;
             }
 
+            /// Round trip time of the last answered server ping. Read it from the connection's handlers.
+            std::chrono::microseconds pong_latency() const override
+            {
+                return pong_latency_;
+            }
+
+            /// Stop at the next message boundary and give the socket to another process.
+
+            ///
+            /// Waits until no message is half-read and all queued data is written, then calls `done`
+            /// with a duplicate of the socket descriptor and drops the connection without a close frame
+            /// and without calling the close handler: the peer stays connected through the duplicate.
+            void handoff(std::function<void(int)> done) override
+            {
+                dispatch([shared_this = this->shared_from_this(), done = std::move(done)]() mutable {
+                    if (shared_this->close_connection_ || shared_this->has_sent_close_)
+                    {
+                        done(-1);
+                        return;
+                    }
+                    shared_this->handoff_handler_ = std::move(done);
+                    shared_this->check_handoff();
+                });
+            }
+
         protected:
-            /// Generate the websocket headers using an opcode and the message size (in bytes).
-            std::string build_header(int opcode, size_t size)
+            /// A queued outgoing frame. The header is kept inline, so queuing a message allocates nothing besides the payload.
+            /// A frame made from a shared_message writes the message's own header and payload instead.
+            struct outgoing_frame
             {
-                char buf[2 + 8] = "\x80\x00";
-                buf[0] += opcode;
-                if (size < 126)
-                {
-                    buf[1] += static_cast<char>(size);
-                    return {buf, buf + 2};
-                }
-                else if (size < 0x10000)
-                {
-                    buf[1] += 126;
-                    *(uint16_t*)(buf + 2) = htons(static_cast<uint16_t>(size));
-                    return {buf, buf + 4};
-                }
-                else
+                std::array<char, 2 + 8> header;
+                uint8_t header_size{0}; // 0 for raw data such as the handshake response
+                std::string payload;
+                shared_message_ptr shared;
+
+                size_t size() const
                 {
-                    buf[1] += 127;
-                    *reinterpret_cast<uint64_t*>(buf + 2) = ((1 == htonl(1)) ? static_cast<uint64_t>(size) : (static_cast<uint64_t>(htonl((size)&0xFFFFFFFF)) << 32) | htonl(static_cast<uint64_t>(size) >> 32));
-                    return {buf, buf + 10};
+                    return shared ? shared->header_size() + shared->payload().size() : header_size + payload.size();
                 }
+            };
+
+            /// Build a frame with the websocket header for the opcode and the payload size (in bytes).
+            static outgoing_frame make_frame(int opcode, std::string payload)
+            {
+                outgoing_frame frame;
+                frame.header_size = detail::encode_frame_header(frame.header.data(), opcode, payload.size());
+                frame.payload = std::move(payload);
+                return frame;
             }
 
             /// Send the HTTP upgrade response.
@@ -328,19 +635,21 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                   "Upgrade: websocket\r\n"
                   "Connection: Upgrade\r\n"
                   "Sec-WebSocket-Accept: ";
-                write_buffers_.emplace_back(header);
-                write_buffers_.emplace_back(std::move(hello));
-                write_buffers_.emplace_back(crlf);
+                outgoing_frame response;
+                response.payload = header + hello + crlf;
                 if (!subprotocol_.empty())
                 {
-                    write_buffers_.emplace_back("Sec-WebSocket-Protocol: ");
-                    write_buffers_.emplace_back(subprotocol_);
-                    write_buffers_.emplace_back(crlf);
+                    response.payload += "Sec-WebSocket-Protocol: ";
+                    response.payload += subprotocol_;
+                    response.payload += crlf;
                 }
-                write_buffers_.emplace_back(crlf);
+                response.payload += crlf;
+                count_queued(response.size());
+                write_buffers_.push_back(std::move(response));
                 do_write();
                 if (open_handler_)
                     open_handler_(*this);
+                schedule_heartbeat();
                 do_read();
             }
 
@@ -362,6 +671,12 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                     return;
                 }
 
+                if (handoff_handler_ && state_ == WebSocketReadState::MiniHeader && message_.empty())
+                {
+                    check_handoff();
+                    return;
+                }
+
                 is_reading = true;
                 switch (state_)
                 {
@@ -421,6 +736,11 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                                   }
                                   shared_this->do_read();
                               }
+                              else if (ec == asio::error::operation_aborted && shared_this->handoff_handler_)
+                              {
+                                  // Read was cancelled to hand the connection off
+                                  shared_this->check_handoff();
+                              }
                               else
                               {
                                   shared_this->close_connection_ = true;
@@ -507,13 +827,13 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                     }
                     break;
                     case WebSocketReadState::Mask:
-                        if (remaining_length_ > max_payload_bytes_)
+                        // Fragments of one message count together, so a large message cannot be split to pass
+                        if (remaining_length_ > max_payload_bytes_ || message_.size() + remaining_length_ > max_payload_bytes_)
                         {
-                            close_connection_ = true;
-                            adaptor_.close();
-                            if (error_handler_)
-                                error_handler_(*this, "Message length exceeds maximum payload.");
-                            check_destroy(MessageTooBig);
+                            CROW_LOG_WARNING << "Websocket " << this << " closed: message of " << message_.size() + remaining_length_
+                                             << " bytes exceeds maximum payload " << max_payload_bytes_;
+                            global_message_limit_stats().oversized++;
+                            abort_connection("Message length exceeds maximum payload.", MessageTooBig);
                         }
                         else if (has_mask_)
                         {
@@ -556,17 +876,21 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                         break;
                     case WebSocketReadState::Payload:
                     {
-                        auto to_read = static_cast<std::uint64_t>(buffer_.size());
+                        // Read straight into fragment_. It grows by at most read_chunk_size bytes per read,
+                        // so a forged length does not allocate memory the peer never sends
+                        auto to_read = static_cast<std::uint64_t>(read_chunk_size);
                         if (remaining_length_ < to_read)
                             to_read = remaining_length_;
+                        size_t offset = fragment_.size();
+                        fragment_.resize(offset + static_cast<std::size_t>(to_read));
                         adaptor_.socket().async_read_some(
-                          asio::buffer(buffer_, static_cast<std::size_t>(to_read)),
-                          [shared_this = this->shared_from_this()](const error_code& ec, std::size_t bytes_transferred) {
+                          asio::buffer(&fragment_[offset], static_cast<std::size_t>(to_read)),
+                          [shared_this = this->shared_from_this(), offset](const error_code& ec, std::size_t bytes_transferred) {
                               shared_this->is_reading = false;
 
                               if (!ec)
                               {
-                                  shared_this->fragment_.insert(shared_this->fragment_.end(), shared_this->buffer_.begin(), shared_this->buffer_.begin() + bytes_transferred);
+                                  shared_this->fragment_.resize(offset + bytes_transferred);
                                   shared_this->remaining_length_ -= bytes_transferred;
                                   if (shared_this->remaining_length_ == 0)
                                   {
@@ -612,12 +936,15 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             /// Unmasks the fragment, checks the opcode, merges fragments into 1 message body, and calls the appropriate handler.
             bool handle_fragment()
             {
+                // Control frames also cost a wakeup of this io_context, so every frame counts as load
+                load_.message_received();
+                load_.bytes_received(fragment_.size());
+                received_since_ping_ = true;
+                if (handler_->socket_options().quick_ack)
+                    crow::detail::rearm_quick_ack(adaptor_.raw_socket());
                 if (has_mask_)
                 {
-                    for (decltype(fragment_.length()) i = 0; i < fragment_.length(); i++)
-                    {
-                        fragment_[i] ^= ((char*)&mask_)[i % 4];
-                    }
+                    detail::unmask(&fragment_[0], fragment_.length(), mask_);
                 }
                 switch (opcode())
                 {
@@ -626,33 +953,31 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                         message_ += fragment_;
                         if (is_FIN())
                         {
-                            if (message_handler_)
+                            bool admitted = admit_message();
+                            if (close_connection_)
+                                return false;
+                            if (admitted && message_handler_)
                                 message_handler_(*this, message_, is_binary_);
                             message_.clear();
                         }
                     }
                     break;
                     case 1: // Text
+                    case 2: // Binary
                     {
-                        is_binary_ = false;
-                        message_ += fragment_;
+                        is_binary_ = opcode() == 2;
                         if (is_FIN())
                         {
-                            if (message_handler_)
-                                message_handler_(*this, message_, is_binary_);
-                            message_.clear();
+                            bool admitted = admit_message();
+                            if (close_connection_)
+                                return false;
+                            // Unfragmented message: hand over the frame buffer itself, nothing is copied
+                            if (admitted && message_handler_)
+                                message_handler_(*this, fragment_, is_binary_);
                         }
-                    }
-                    break;
-                    case 2: // Binary
-                    {
-                        is_binary_ = true;
-                        message_ += fragment_;
-                        if (is_FIN())
+                        else
                         {
-                            if (message_handler_)
-                                message_handler_(*this, message_, is_binary_);
-                            message_.clear();
+                            message_ = std::move(fragment_);
                         }
                     }
                     break;
@@ -696,12 +1021,26 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                     break;
                     case 0x9: // Ping
                     {
-                        send_pong(fragment_);
+                        // Each pong is a write, so pings are limited like messages
+                        bool admitted = admit_message();
+                        if (close_connection_)
+                            return false;
+                        if (admitted)
+                            send_pong(fragment_);
                     }
                     break;
                     case 0xA: // Pong
                     {
-                        pong_received_ = true;
+                        // An unsolicited or late pong carries another payload and only counts as activity
+                        if (awaiting_pong_ && fragment_ == std::to_string(ping_id_))
+                        {
+                            awaiting_pong_ = false;
+                            pong_latency_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - ping_sent_at_);
+                            auto& stats = global_heartbeat_stats();
+                            stats.pongs++;
+                            stats.latency_us += pong_latency_.count();
+                        }
                     }
                     break;
                 }
@@ -719,21 +1058,33 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 if (sending_buffers_.empty()) {
                     if (write_buffers_.empty()) return;
 
+                    // Everything queued so far goes out in one gather write
                     sending_buffers_.swap(write_buffers_);
                     std::vector<asio::const_buffer> buffers;
-                    buffers.reserve(sending_buffers_.size());
-                    for (auto &s: sending_buffers_)
+                    buffers.reserve(sending_buffers_.size() * 2);
+                    for (auto& frame : sending_buffers_)
                     {
-                        buffers.emplace_back(asio::buffer(s));
+                        if (frame.shared)
+                        {
+                            buffers.emplace_back(asio::buffer(frame.shared->header(), frame.shared->header_size()));
+                            buffers.emplace_back(asio::buffer(frame.shared->payload()));
+                            continue;
+                        }
+                        if (frame.header_size != 0)
+                            buffers.emplace_back(asio::buffer(frame.header.data(), frame.header_size));
+                        buffers.emplace_back(asio::buffer(frame.payload));
                     }
                     auto watch = std::weak_ptr<void>{anchor_};
                     asio::async_write(
                         adaptor_.socket(), buffers,
-                        [shared_this = this->shared_from_this(), watch](const error_code &ec, std::size_t /*bytes_transferred*/) {
+                        [shared_this = this->shared_from_this(), watch](const error_code &ec, std::size_t bytes_transferred) {
                             auto anchor = watch.lock();
                             if (anchor == nullptr)
                                 return;
 
+                            shared_this->load_.bytes_sent(bytes_transferred);
+                            for (auto& frame : shared_this->sending_buffers_)
+                                shared_this->count_dequeued(frame.size());
                             if (!ec && !shared_this->close_connection_)
                             {
                                 shared_this->sending_buffers_.clear();
@@ -741,6 +1092,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                                     shared_this->do_write();
                                 if (shared_this->has_sent_close_)
                                     shared_this->close_connection_ = true;
+                                shared_this->check_handoff();
                             }
                             else
                             {
@@ -752,6 +1104,126 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 }
             }
 
+            /// Disconnect a peer that does not read what is sent to it.
+            ///
+            /// A close frame would wait behind the unread data, so the socket is closed right away.
+            void evict_slow_consumer()
+            {
+                CROW_LOG_WARNING << "Websocket " << this << " evicted: " << queued_bytes_ << " bytes in "
+                                 << write_buffers_.size() + sending_buffers_.size() << " messages are not read";
+                global_send_queue_stats().evicted++;
+                abort_connection("Send queue limit exceeded", CloseStatusCode::PolicyViolated);
+            }
+
+            /// Close the socket right away, without a close handshake, dropping everything queued.
+            void abort_connection(const std::string& reason, websocket::CloseStatusCode code)
+            {
+                for (auto& frame : write_buffers_)
+                    count_dequeued(frame.size());
+                write_buffers_.clear();
+                close_connection_ = true;
+                adaptor_.shutdown_readwrite();
+                adaptor_.close();
+                if (error_handler_)
+                    error_handler_(*this, reason);
+                check_destroy(code);
+                is_close_handler_called_ = true; // The pending read and write fail next, the close handler already ran
+            }
+
+            /// Take a token for an incoming message. Returns false if the message is to be dropped;
+            /// closes the connection when too many messages in a row were dropped.
+            bool admit_message()
+            {
+                auto limit = handler_->websocket_rate_limit();
+                if (limit.rate <= 0 || rate_bucket_.take(limit.rate, limit.burst))
+                {
+                    dropped_in_row_ = 0;
+                    return true;
+                }
+
+                auto& stats = global_message_limit_stats();
+                stats.dropped++;
+                if (limit.max_dropped != 0 && ++dropped_in_row_ >= limit.max_dropped)
+                {
+                    CROW_LOG_WARNING << "Websocket " << this << " closed: " << dropped_in_row_ << " messages over the rate limit";
+                    stats.disconnected++;
+                    abort_connection("Message rate limit exceeded", CloseStatusCode::PolicyViolated);
+                }
+                return false;
+            }
+
+            /// Put the next heartbeat of this connection on the io_context's timer wheel.
+            void schedule_heartbeat()
+            {
+                auto settings = handler_->websocket_heartbeat();
+                if (settings.interval.count() <= 0)
+                    return;
+                wheel_.schedule(settings.interval, [weak = this->weak_from_this()]() {
+                    if (auto self = weak.lock())
+                        self->heartbeat();
+                });
+            }
+
+            /// Count the missed ping, give up on a silent peer or send the next ping.
+            void heartbeat()
+            {
+                if (close_connection_ || has_sent_close_ || handoff_handler_)
+                    return;
+
+                auto settings = handler_->websocket_heartbeat();
+                if (awaiting_pong_ && !received_since_ping_)
+                    missed_pings_++;
+                else
+                    missed_pings_ = 0;
+
+                if (missed_pings_ >= settings.max_missed)
+                {
+                    CROW_LOG_WARNING << "Websocket " << this << " timed out: no answer to " << missed_pings_ << " pings";
+                    global_heartbeat_stats().timed_out++;
+                    abort_connection("Heartbeat timeout", CloseStatusCode::ClosedAbnormally);
+                    return;
+                }
+
+                awaiting_pong_ = true;
+                received_since_ping_ = false;
+                ping_sent_at_ = std::chrono::steady_clock::now();
+                queue_frame(make_frame(0x9, std::to_string(++ping_id_)));
+                schedule_heartbeat();
+            }
+
+            /// Hand the socket off once the connection is between messages and has nothing left to write.
+            void check_handoff()
+            {
+                if (!handoff_handler_ || close_connection_)
+                    return;
+                if (!sending_buffers_.empty() || !write_buffers_.empty())
+                    return; // Called again when the write completes
+                if (is_reading)
+                {
+                    // Only a read of the next frame header may be interrupted: nothing of the frame is consumed yet.
+                    // Otherwise the frame is read to the end and do_read() stops at the boundary.
+                    if (state_ == WebSocketReadState::MiniHeader && message_.empty())
+                    {
+                        error_code ec;
+                        adaptor_.raw_socket().cancel(ec);
+                    }
+                    return;
+                }
+
+                auto done = std::move(handoff_handler_);
+                handoff_handler_ = nullptr;
+#ifndef _WIN32
+                int fd = ::dup(adaptor_.raw_socket().native_handle());
+#else
+                int fd = -1;
+#endif
+                close_connection_ = true;
+                is_close_handler_called_ = true; // The connection lives on in the other process
+                adaptor_.close();
+                done(fd);
+                handler_->remove_websocket(this->shared_from_this());
+            }
+
             /// Destroy the Connection.
             void check_destroy(websocket::CloseStatusCode code = CloseStatusCode::ClosedAbnormally)
             {
@@ -781,12 +1253,66 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 }
             };
 
+            /// Track the send queue size of this connection and of its io_context
+            void count_queued(size_t size)
+            {
+                queued_bytes_ += size;
+                load_.frame_queued(size);
+            }
+
+            void count_dequeued(size_t size)
+            {
+                queued_bytes_ -= size;
+                load_.frame_dequeued(size);
+            }
+
             void send_data_impl(SendMessageType* s)
             {
-                auto header = build_header(s->opcode, s->payload.size());
-                write_buffers_.emplace_back(std::move(header));
-                write_buffers_.emplace_back(std::move(s->payload));
-                do_write();
+                queue_frame(make_frame(s->opcode, std::move(s->payload)));
+            }
+
+            void queue_frame(outgoing_frame&& frame)
+            {
+                if (close_connection_)
+                    return;
+
+                // Only the latest value matters: drop the superseded message that is still waiting
+                if (frame.shared && frame.shared->conflation_key() != 0)
+                {
+                    auto key = frame.shared->conflation_key();
+                    for (auto it = write_buffers_.begin(); it != write_buffers_.end(); ++it)
+                    {
+                        if (it->shared && it->shared->conflation_key() == key)
+                        {
+                            count_dequeued(it->size());
+                            write_buffers_.erase(it);
+                            global_send_queue_stats().conflated++;
+                            break;
+                        }
+                    }
+                }
+
+                count_queued(frame.size());
+                write_buffers_.push_back(std::move(frame));
+
+                auto limits = handler_->websocket_send_queue_limits();
+                if ((limits.max_bytes != 0 && queued_bytes_ > limits.max_bytes) ||
+                    (limits.max_messages != 0 && write_buffers_.size() + sending_buffers_.size() > limits.max_messages))
+                {
+                    evict_slow_consumer();
+                    return;
+                }
+
+                // Defer the write to the end of the queued handlers, so messages sent back to back
+                // (e.g. STATE followed by YOUR_TURN) are coalesced into a single write
+                if (!flush_scheduled_)
+                {
+                    flush_scheduled_ = true;
+                    post([this]() {
+                        flush_scheduled_ = false;
+                        do_write();
+                    });
+                }
             }
 
             void send_data(int opcode, std::string&& msg)
@@ -802,7 +1328,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
         private:
             Connection(Adaptor&& adaptor, Handler* handler, uint64_t max_payload,
                        std::function<void(crow::websocket::connection&)> open_handler,
-                       std::function<void(crow::websocket::connection&, const std::string&, bool)> message_handler,
+                       message_handler_type message_handler,
                        std::function<void(crow::websocket::connection&, const std::string&, uint16_t)> close_handler,
                        std::function<void(crow::websocket::connection&, const std::string&)> error_handler,
                        std::function<void(const crow::request&, std::optional<crow::response>&, void**)> accept_handler):
@@ -813,16 +1339,22 @@ namespace crow // NOTE: Already documented in "crow/app.h"
               message_handler_(std::move(message_handler)),
               close_handler_(std::move(close_handler)),
               error_handler_(std::move(error_handler)),
-              accept_handler_(std::move(accept_handler))
-            {}
+              accept_handler_(std::move(accept_handler)),
+              load_(crow::detail::io_context_load::of(adaptor_.get_io_context())),
+              wheel_(crow::detail::timer_wheel::of(adaptor_.get_io_context()))
+            {
+                load_.websocket_opened();
+            }
 
             Adaptor adaptor_;
             Handler* handler_;
 
-            std::vector<std::string> sending_buffers_;
-            std::vector<std::string> write_buffers_;
+            std::vector<outgoing_frame> sending_buffers_;
+            std::vector<outgoing_frame> write_buffers_;
+            bool flush_scheduled_{false};
+            uint64_t queued_bytes_{0};
 
-            std::array<char, 4096> buffer_;
+            static constexpr size_t read_chunk_size = 16384;
             bool is_binary_;
             std::string message_;
             std::string fragment_;
@@ -839,16 +1371,26 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             bool has_sent_close_{false};
             bool has_recv_close_{false};
             bool error_occurred_{false};
-            bool pong_received_{false};
+            bool awaiting_pong_{false};
+            bool received_since_ping_{false};
+            uint32_t ping_id_{0};
+            uint32_t missed_pings_{0};
+            std::chrono::steady_clock::time_point ping_sent_at_;
+            std::chrono::microseconds pong_latency_{0};
+            detail::token_bucket rate_bucket_;
+            uint32_t dropped_in_row_{0};
             bool is_close_handler_called_{false};
 
             std::shared_ptr<void> anchor_ = std::make_shared<int>(); // Value is just for placeholding
 
             std::function<void(crow::websocket::connection&)> open_handler_;
-            std::function<void(crow::websocket::connection&, const std::string&, bool)> message_handler_;
+            message_handler_type message_handler_;
             std::function<void(crow::websocket::connection&, const std::string&, uint16_t status_code)> close_handler_;
             std::function<void(crow::websocket::connection&, const std::string&)> error_handler_;
             std::function<void(const crow::request&, std::optional<crow::response>&, void**)> accept_handler_;
+            std::function<void(int)> handoff_handler_;
+            crow::detail::io_context_load& load_;
+            crow::detail::timer_wheel& wheel_;
         };
     } // namespace websocket
 } // namespace crow
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "types.h"
+#include <string>
+
+// Поток событий игрока с порядковыми номерами.
+//
+// Каждое игровое событие получает поле "seq" и сохраняется в outbox игрока,
+// чтобы после переподключения (RESUME) можно было дослать только те события,
+// которые клиент еще не подтвердил. Все методы вызываются под мьютексом сессии.
+class EventStream {
+public:
+    // Сколько последних событий хранится для повторной отправки
+    static constexpr size_t kMaxOutbox = 64;
+
+    // Ключи объединения: STATE содержит все поле целиком, поэтому медленному
+    // клиенту достаточно последнего еще не отправленного STATE каждого вида
+    static constexpr uint32_t kStateMyShot = 1;
+    static constexpr uint32_t kStateEnemyShot = 2;
+
+    // Отправить событие игроку (или только сохранить, если он отключен)
+    // Сообщение создается один раз и разделяется между outbox и очередью соединения
+    static void send(Player& player, const std::string& json, uint32_t conflationKey = 0) {
+        uint64_t seq = ++player.lastSeq;
+        auto message = crow::websocket::shared_message::text(withSeq(json, seq), conflationKey);
+
+        if (player.outbox.size() >= kMaxOutbox) {
+            player.outbox.pop_front();
+        }
+        player.outbox.emplace_back(seq, message);
+
+        if (player.socket) {
+            player.socket->send(std::move(message));
+        }
+    }
+
+    // Можно ли дослать события после lastSeq из outbox. Если нет (события
+    // уже вытеснены или сервер перезапускался), клиенту нужна полная синхронизация
+    static bool canReplay(const Player& player, uint64_t lastSeq) {
+        if (lastSeq > player.lastSeq) {
+            return false; // Клиент видел больше событий, чем помнит сервер
+        }
+        if (lastSeq == player.lastSeq) {
+            return true;
+        }
+        return !player.outbox.empty() && player.outbox.front().first <= lastSeq + 1;
+    }
+
+    // Дослать события после lastSeq
+    static void replay(Player& player, uint64_t lastSeq) {
+        if (!player.socket) {
+            return;
+        }
+        for (const auto& [seq, message] : player.outbox) {
+            if (seq > lastSeq) {
+                player.socket->send(message);
+            }
+        }
+    }
+
+    // Клиент подтвердил получение событий до seq включительно
+    static void acknowledge(Player& player, uint64_t seq) {
+        while (!player.outbox.empty() && player.outbox.front().first <= seq) {
+            player.outbox.pop_front();
+        }
+    }
+
+private:
+    // Вставка "seq" первым полем JSON объекта без повторной сериализации
+    static std::string withSeq(const std::string& json, uint64_t seq) {
+        if (json.empty() || json[0] != '{') {
+            return json;
+        }
+        std::string result = "{\"seq\":" + std::to_string(seq);
+        if (json.size() > 2) {
+            result += ',';
+        }
+        result.append(json, 1, std::string::npos);
+        return result;
+    }
+};
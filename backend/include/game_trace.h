@@ -0,0 +1,376 @@
+#pragma once
+
+#include <crow/logging.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+// Двоичная трасса игр для разбора после (планирование мощности, проверка
+// жалоб на читы).
+//
+// Каждое событие - запись фиксированного размера: открытие и закрытие
+// соединения и каждое обработанное сообщение с комнатой, игроком, клеткой
+// и результатом выстрела и временем обработки. Игровой поток кладет запись
+// в свой кольцевой буфер без блокировок; поток трассы раз в flushMs
+// переносит накопленное в файл. Файлы сменяются по размеру, старые
+// удаляются. Если буфер потока полон, запись отбрасывается и учитывается
+// в dropped().
+//
+// Файл: заголовок FileHeader и записи Record подряд, порядок байтов
+// машины. Разбирает tools/trace_decode.cpp.
+class GameTrace {
+public:
+    enum Event : uint8_t {
+        Message = 0,
+        Open = 1,
+        Close = 2
+    };
+
+    // Результат выстрела в Record::result: ShotResult + 1, 0 - не выстрел
+    static constexpr uint8_t kNoShot = 0;
+
+    struct Record {
+        uint64_t timeNs;       // Время события, наносекунды от эпохи Unix
+        uint64_t connection;   // Идентификатор соединения (адрес, уникален в пределах процесса)
+        uint32_t room;         // Код комнаты как шестнадцатеричное число, kNoRoom - комната неизвестна
+        uint32_t latencyUs;    // Время обработки сообщения
+        uint8_t event;         // Event
+        uint8_t messageType;   // Номер типа сообщения (Metrics::messageTypeName)
+        uint8_t player;        // 1 или 2, 0 - игрок неизвестен
+        uint8_t x;             // Клетка выстрела
+        uint8_t y;
+        uint8_t result;        // ShotResult + 1
+        uint8_t reserved[2];
+    };
+    static_assert(sizeof(Record) == 32, "trace record layout is part of the file format");
+
+    static constexpr uint32_t kNoRoom = 0xFFFFFFFF;
+    // Тип сообщения, которое не удалось разобрать
+    static constexpr uint8_t kUnknownType = 0xFF;
+
+    struct FileHeader {
+        char magic[8];         // "SBTRACE\0"
+        uint32_t version;
+        uint32_t recordSize;
+    };
+    static constexpr char kMagic[8] = {'S', 'B', 'T', 'R', 'A', 'C', 'E', '\0'};
+    static constexpr uint32_t kVersion = 1;
+
+    GameTrace() = default;
+    GameTrace(const GameTrace&) = delete;
+    GameTrace& operator=(const GameTrace&) = delete;
+
+    ~GameTrace() {
+        stop();
+    }
+
+    // Код комнаты из 6 шестнадцатеричных символов в число
+    static uint32_t encodeRoom(const std::string& roomCode) {
+        if (roomCode.empty() || roomCode.size() > 6) {
+            return kNoRoom;
+        }
+        uint32_t value = 0;
+        for (char c : roomCode) {
+            int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (digit < 0) {
+                return kNoRoom;
+            }
+            value = value * 16 + static_cast<uint32_t>(digit);
+        }
+        return value;
+    }
+
+    static uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    // Начать запись в каталог dir: файлы trace-<время>.sbt не больше
+    // fileBytes, хранятся последние maxFiles
+    bool start(const std::string& dir, uint64_t fileBytes, unsigned maxFiles, unsigned flushMs) {
+        dir_ = dir;
+        fileBytes_ = fileBytes;
+        maxFiles_ = maxFiles;
+        flushInterval_ = std::chrono::milliseconds(flushMs);
+        files_ = listFiles(dir);
+        if (!openFile()) {
+            return false;
+        }
+        stopping_ = false;
+        enabled_ = true;
+        writer_ = std::thread([this] {
+#ifdef __linux__
+            pthread_setname_np(pthread_self(), "sb-trace");
+#endif
+            writerLoop();
+        });
+        return true;
+    }
+
+    // Записать оставшееся и остановить поток трассы
+    void stop() {
+        if (!writer_.joinable()) {
+            return;
+        }
+        enabled_ = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        writer_.join();
+        drain();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    bool isEnabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Вызывается из любого потока; без блокировок, кроме первой записи потока
+    void record(const Record& record) {
+        if (!isEnabled()) {
+            return;
+        }
+        Ring& ring = localRing();
+        size_t head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.tail.load(std::memory_order_acquire) == kRingSize) {
+            ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        ring.records[head % kRingSize] = record;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    // Записи, отброшенные из-за переполненного буфера потока
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        uint64_t total = 0;
+        for (const auto& ring : rings_) {
+            total += ring->dropped.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Запись об обработанном сообщении: заполняется по ходу обработки и
+    // отправляется в трассу при выходе из обработчика
+    class MessageScope {
+    public:
+        MessageScope(GameTrace& trace, const void* connection) : trace_(trace.isEnabled() ? &trace : nullptr) {
+            if (trace_) {
+                start_ = std::chrono::steady_clock::now();
+                record_.timeNs = nowNs();
+                record_.connection = reinterpret_cast<uintptr_t>(connection);
+                record_.room = kNoRoom;
+                record_.event = Message;
+                record_.messageType = kUnknownType;
+            }
+        }
+
+        ~MessageScope() {
+            if (trace_) {
+                auto elapsedUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start_).count());
+                record_.latencyUs = static_cast<uint32_t>(std::min<uint64_t>(elapsedUs, UINT32_MAX));
+                trace_->record(record_);
+            }
+        }
+
+        MessageScope(const MessageScope&) = delete;
+        MessageScope& operator=(const MessageScope&) = delete;
+
+        void messageType(size_t type) {
+            record_.messageType = static_cast<uint8_t>(type);
+        }
+
+        void session(const std::string& roomCode, int player) {
+            if (trace_) {
+                record_.room = encodeRoom(roomCode);
+                record_.player = static_cast<uint8_t>(player);
+            }
+        }
+
+        void shot(int x, int y, int shotResult) {
+            record_.x = static_cast<uint8_t>(x);
+            record_.y = static_cast<uint8_t>(y);
+            record_.result = static_cast<uint8_t>(shotResult + 1);
+        }
+
+    private:
+        GameTrace* trace_;
+        std::chrono::steady_clock::time_point start_;
+        Record record_{};
+    };
+
+private:
+    static constexpr size_t kRingSize = 8192; // 256 КБ на поток
+
+    struct Ring {
+        std::array<Record, kRingSize> records;
+        alignas(64) std::atomic<size_t> head{0};       // Пишет игровой поток
+        std::atomic<uint64_t> dropped{0};              // Пишет игровой поток
+        alignas(64) std::atomic<size_t> tail{0};       // Пишет поток трассы
+    };
+
+    Ring& localRing() {
+        // Трасса в процессе одна, кольцо потока создается при его первой записи
+        thread_local Ring* ring = nullptr;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            rings_.push_back(std::make_unique<Ring>());
+            ring = rings_.back().get();
+        }
+        return *ring;
+    }
+
+    // Файлы трассы в каталоге от старых к новым (имена начинаются со времени)
+    static std::vector<std::string> listFiles(const std::string& dir) {
+        std::vector<std::string> files;
+        DIR* d = opendir(dir.c_str());
+        if (!d) {
+            return files;
+        }
+        while (dirent* entry = readdir(d)) {
+            std::string name = entry->d_name;
+            if (name.rfind("trace-", 0) == 0 && name.size() > 4 && name.compare(name.size() - 4, 4, ".sbt") == 0) {
+                files.push_back(dir + "/" + name);
+            }
+        }
+        closedir(d);
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    bool openFile() {
+        char stamp[32];
+        time_t now = time(nullptr);
+        tm utc;
+        gmtime_r(&now, &utc);
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &utc);
+        // Номер процесса и файла в имени: за одну секунду может смениться
+        // несколько файлов, а перезапущенный процесс не должен затереть старый
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "-%d-%04u.sbt", static_cast<int>(::getpid()), fileIndex_++);
+        std::string path = dir_ + "/trace-" + stamp + suffix;
+
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            CROW_LOG_ERROR << "[Trace] Failed to open " << path << ": " << std::strerror(errno);
+            return false;
+        }
+        FileHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.recordSize = sizeof(Record);
+        if (!writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header))) {
+            ::close(fd);
+            return false;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        fd_ = fd;
+        fileSize_ = sizeof(header);
+        files_.push_back(path);
+        while (maxFiles_ > 0 && files_.size() > maxFiles_) {
+            ::unlink(files_.front().c_str());
+            files_.erase(files_.begin());
+        }
+        return true;
+    }
+
+    bool writeAll(int fd, const char* data, size_t size) {
+        size_t written = 0;
+        while (written < size) {
+            ssize_t n = ::write(fd, data + written, size - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                CROW_LOG_ERROR << "[Trace] write failed: " << std::strerror(errno);
+                return false;
+            }
+            written += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Перенести записи из буферов потоков в файл
+    void drain() {
+        std::vector<Ring*> rings;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            for (auto& ring : rings_) {
+                rings.push_back(ring.get());
+            }
+        }
+
+        batch_.clear();
+        for (Ring* ring : rings) {
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                const Record& record = ring->records[tail % kRingSize];
+                const char* bytes = reinterpret_cast<const char*>(&record);
+                batch_.insert(batch_.end(), bytes, bytes + sizeof(Record));
+            }
+            ring->tail.store(tail, std::memory_order_release);
+        }
+        if (batch_.empty()) {
+            return;
+        }
+        if (fileSize_ + batch_.size() > fileBytes_ && fileSize_ > sizeof(FileHeader)) {
+            openFile();
+        }
+        if (writeAll(fd_, batch_.data(), batch_.size())) {
+            fileSize_ += batch_.size();
+        }
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            cv_.wait_for(lock, flushInterval_, [this] { return stopping_; });
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    std::string dir_;
+    uint64_t fileBytes_ = 0;
+    unsigned maxFiles_ = 0;
+    std::chrono::milliseconds flushInterval_{100};
+
+    // Только поток трассы (и stop после его завершения)
+    int fd_ = -1;
+    uint64_t fileSize_ = 0;
+    unsigned fileIndex_ = 0;
+    std::vector<std::string> files_;
+    std::vector<char> batch_;
+
+    std::mutex ringsMutex_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::atomic<bool> enabled_{false};
+    std::thread writer_;
+};
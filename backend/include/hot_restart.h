@@ -0,0 +1,410 @@
+#pragma once
+
+#include "types.h"
+#include "session_journal.h"
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <crow/logging.h>
+#include <optional>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Горячий перезапуск: передача работы новому процессу без разрыва соединений.
+//
+// Работающий процесс слушает Unix socket (--handoff). Новый процесс при
+// старте подключается к нему и просит передать работу. Старый процесс
+// перестает принимать соединения, останавливает каждое WebSocket соединение
+// на границе сообщения и отправляет новому слушающий сокет, дескрипторы
+// соединений (SCM_RIGHTS) и состояние сессий, после чего завершается.
+// TCP соединения клиентов остаются теми же, поэтому клиенты перезапуска
+// не замечают.
+//
+// Протокол: новый процесс шлет байт 'T'; старый отвечает
+// [u64 размер][состояние], затем дескрипторами пачками по kFdsPerMessage
+// (первый - слушающий сокет, дальше соединения по порядку clients);
+// новый процесс подтверждает прием байтом 'K'.
+class HotRestart {
+public:
+    // Соединение клиента, переданное новому процессу
+    struct Client {
+        int fd = -1;
+        std::string roomCode;      // Пусто, если соединение еще не в игре
+        bool isPlayer1 = false;
+        uint64_t deliveredSeq = 0; // Последнее событие, записанное в сокет
+    };
+
+    struct State {
+        int listenerFd = -1;
+        std::vector<std::shared_ptr<GameSession>> sessions;
+        std::vector<Client> clients;
+    };
+
+    using Provider = std::function<State()>;
+
+    HotRestart() = default;
+    HotRestart(const HotRestart&) = delete;
+    HotRestart& operator=(const HotRestart&) = delete;
+
+    ~HotRestart() {
+        stop();
+    }
+
+    // Новый процесс: забрать работу у запущенного (nullopt - его нет, обычный старт)
+    static std::optional<State> takeOver(const std::string& path) {
+        int fd = connectTo(path);
+        if (fd < 0) {
+            return std::nullopt;
+        }
+
+        CROW_LOG_INFO << "[HotRestart] Taking over from running process at " << path;
+        std::optional<State> state;
+        char request = 'T';
+        uint64_t size = 0;
+        std::string blob;
+        if (writeAll(fd, &request, 1) && readAll(fd, &size, sizeof(size))) {
+            blob.resize(size);
+            if (readAll(fd, &blob[0], size)) {
+                state = decodeState(blob);
+            }
+        }
+
+        if (state) {
+            std::vector<int> fds;
+            size_t expected = state->clients.size() + 1;
+            if (receiveFds(fd, expected, fds)) {
+                state->listenerFd = fds[0];
+                for (size_t i = 0; i < state->clients.size(); ++i) {
+                    state->clients[i].fd = fds[i + 1];
+                }
+                char ack = 'K';
+                writeAll(fd, &ack, 1);
+                CROW_LOG_INFO << "[HotRestart] Received " << state->sessions.size() << " sessions and "
+                          << state->clients.size() << " connections";
+            } else {
+                for (int received : fds) ::close(received);
+                state.reset();
+            }
+        }
+
+        if (!state) {
+            CROW_LOG_WARNING << "[HotRestart] Takeover failed, starting from scratch";
+        }
+        ::close(fd);
+        return state;
+    }
+
+    // Старый процесс: ждать запроса на передачу работы в отдельном потоке.
+    // provider готовит состояние, onDone вызывается после того, как новый
+    // процесс подтвердил прием
+    bool listen(const std::string& path, Provider provider, std::function<void()> onDone) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            CROW_LOG_ERROR << "[HotRestart] Socket path too long: " << path;
+            return false;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ::unlink(path.c_str());
+        if (listenFd_ < 0 || ::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd_, 1) != 0) {
+            CROW_LOG_ERROR << "[HotRestart] Cannot listen on " << path << ": " << std::strerror(errno);
+            if (listenFd_ >= 0) ::close(listenFd_);
+            listenFd_ = -1;
+            return false;
+        }
+        ::chmod(path.c_str(), 0600);
+
+        thread_ = std::thread([this, provider = std::move(provider), onDone = std::move(onDone)] {
+            serve(provider, onDone);
+        });
+        CROW_LOG_INFO << "[HotRestart] Waiting for handoff requests at " << path;
+        return true;
+    }
+
+    void stop() {
+        if (listenFd_ >= 0) {
+            ::shutdown(listenFd_, SHUT_RDWR); // Прерывает accept
+        }
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        if (listenFd_ >= 0) {
+            ::close(listenFd_);
+            listenFd_ = -1;
+        }
+    }
+
+private:
+    static constexpr size_t kFdsPerMessage = 200;
+
+    void serve(const Provider& provider, const std::function<void()>& onDone) {
+        while (true) {
+            int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return; // stop()
+            }
+
+            char request = 0;
+            if (!readAll(fd, &request, 1) || request != 'T') {
+                ::close(fd);
+                continue;
+            }
+
+            CROW_LOG_INFO << "[HotRestart] Handoff requested";
+            State state = provider();
+            std::string blob = encodeState(state);
+            uint64_t size = blob.size();
+
+            std::vector<int> fds;
+            fds.push_back(state.listenerFd);
+            for (const auto& client : state.clients) {
+                fds.push_back(client.fd);
+            }
+
+            char ack = 0;
+            bool sent = writeAll(fd, &size, sizeof(size)) && writeAll(fd, blob.data(), blob.size()) &&
+                        sendFds(fd, fds) && readAll(fd, &ack, 1) && ack == 'K';
+            ::close(fd);
+            for (int passed : fds) {
+                if (passed >= 0) ::close(passed); // Новый процесс держит свои копии
+            }
+
+            if (sent) {
+                CROW_LOG_INFO << "[HotRestart] Handed off " << state.sessions.size() << " sessions and "
+                          << state.clients.size() << " connections";
+            } else {
+                // Соединения уже отданы, продолжать работу нельзя: клиенты вернутся через RESUME
+                CROW_LOG_ERROR << "[HotRestart] Handoff failed";
+            }
+            onDone();
+            return;
+        }
+    }
+
+    // ==================== Кодирование состояния ====================
+
+    template<typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void putStr(std::string& out, const std::string& value) {
+        put<uint32_t>(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    struct Reader {
+        const std::string& data;
+        size_t pos = 0;
+        bool ok = true;
+
+        template<typename T>
+        T get() {
+            T value{};
+            if (pos + sizeof(T) > data.size()) {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, data.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return value;
+        }
+
+        std::string str() {
+            uint32_t size = get<uint32_t>();
+            if (!ok || pos + size > data.size()) {
+                ok = false;
+                return {};
+            }
+            std::string value = data.substr(pos, size);
+            pos += size;
+            return value;
+        }
+    };
+
+    static void putPlayer(std::string& out, const Player& player) {
+        put<uint64_t>(out, player.lastSeq);
+        put<uint32_t>(out, static_cast<uint32_t>(player.outbox.size()));
+        for (const auto& [seq, message] : player.outbox) {
+            put<uint64_t>(out, seq);
+            putStr(out, message->payload());
+        }
+    }
+
+    static void getPlayer(Reader& reader, Player& player) {
+        player.lastSeq = reader.get<uint64_t>();
+        uint32_t count = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < count && reader.ok; ++i) {
+            uint64_t seq = reader.get<uint64_t>();
+            player.outbox.emplace_back(seq, crow::websocket::shared_message::text(reader.str()));
+        }
+    }
+
+    static std::string encodeState(const State& state) {
+        std::string out;
+        put<uint32_t>(out, static_cast<uint32_t>(state.sessions.size()));
+        for (const auto& session : state.sessions) {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            putStr(out, SessionJournal::encodeSession(*session));
+            putPlayer(out, session->player1);
+            putPlayer(out, session->player2);
+        }
+        put<uint32_t>(out, static_cast<uint32_t>(state.clients.size()));
+        for (const auto& client : state.clients) {
+            putStr(out, client.roomCode);
+            put<uint8_t>(out, client.isPlayer1 ? 1 : 0);
+            put<uint64_t>(out, client.deliveredSeq);
+        }
+        return out;
+    }
+
+    static std::optional<State> decodeState(const std::string& blob) {
+        State state;
+        Reader reader{blob};
+
+        uint32_t sessionCount = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < sessionCount && reader.ok; ++i) {
+            auto session = SessionJournal::decodeSession(reader.str());
+            Player player1, player2;
+            getPlayer(reader, player1);
+            getPlayer(reader, player2);
+            if (!session) {
+                reader.ok = false;
+                break;
+            }
+            session->player1.lastSeq = player1.lastSeq;
+            session->player1.outbox = std::move(player1.outbox);
+            session->player2.lastSeq = player2.lastSeq;
+            session->player2.outbox = std::move(player2.outbox);
+            state.sessions.push_back(session);
+        }
+
+        uint32_t clientCount = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < clientCount && reader.ok; ++i) {
+            Client client;
+            client.roomCode = reader.str();
+            client.isPlayer1 = reader.get<uint8_t>() != 0;
+            client.deliveredSeq = reader.get<uint64_t>();
+            state.clients.push_back(client);
+        }
+
+        if (!reader.ok) {
+            return std::nullopt;
+        }
+        return state;
+    }
+
+    // ==================== Ввод-вывод ====================
+
+    static int connectTo(const std::string& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            return -1;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return -1; // Никто не слушает - предыдущего процесса нет
+        }
+        return fd;
+    }
+
+    static bool writeAll(int fd, const void* data, size_t size) {
+        const char* pos = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = ::send(fd, pos, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            pos += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    static bool readAll(int fd, void* data, size_t size) {
+        char* pos = static_cast<char*>(data);
+        while (size > 0) {
+            ssize_t got = ::recv(fd, pos, size, 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            pos += got;
+            size -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    // Каждая пачка дескрипторов идет с одним байтом данных
+    static bool sendFds(int fd, const std::vector<int>& fds) {
+        for (size_t offset = 0; offset < fds.size(); offset += kFdsPerMessage) {
+            size_t count = std::min(kFdsPerMessage, fds.size() - offset);
+            std::vector<char> control(CMSG_SPACE(sizeof(int) * count));
+            char marker = 'F';
+            iovec iov{&marker, 1};
+
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control.data();
+            message.msg_controllen = control.size();
+
+            cmsghdr* header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+            std::memcpy(CMSG_DATA(header), fds.data() + offset, sizeof(int) * count);
+
+            ssize_t sent;
+            do {
+                sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+            } while (sent < 0 && errno == EINTR);
+            if (sent != 1) return false;
+        }
+        return true;
+    }
+
+    static bool receiveFds(int fd, size_t expected, std::vector<int>& fds) {
+        while (fds.size() < expected) {
+            size_t count = std::min(kFdsPerMessage, expected - fds.size());
+            std::vector<char> control(CMSG_SPACE(sizeof(int) * count));
+            char marker;
+            iovec iov{&marker, 1};
+
+            msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control.data();
+            message.msg_controllen = control.size();
+
+            ssize_t got;
+            do {
+                got = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+            } while (got < 0 && errno == EINTR);
+            if (got != 1) return false;
+
+            for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+                if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) continue;
+                size_t received = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const int* data = reinterpret_cast<const int*>(CMSG_DATA(header));
+                fds.insert(fds.end(), data, data + received);
+            }
+            if (message.msg_flags & MSG_CTRUNC) return false;
+        }
+        return true;
+    }
+
+    int listenFd_ = -1;
+    std::thread thread_;
+};
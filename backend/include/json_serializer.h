@@ -1,30 +1,69 @@
 #pragma once
 
 #include "types.h"
+#include "latency_histograms.h"
 #include <crow.h>
 #include <sstream>
 #include <iomanip>
 
+// Время сборки каждого сообщения учитывается в замере обрабатываемого
+// входящего сообщения (MessageTiming)
 class JsonSerializer {
 public:
     // Создание сессии
-    static std::string sessionCreated(const std::string& roomCode) {
+    static std::string sessionCreated(const std::string& roomCode, const std::string& reconnectToken) {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "SESSION_CREATED";
         msg["roomCode"] = roomCode;
+        msg["reconnectToken"] = reconnectToken;
         return msg.dump();
     }
     
     // Начало игры
-    static std::string gameStart(int firstTurn) {
+    static std::string gameStart(int firstTurn, const std::string& roomCode, const std::string& reconnectToken) {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "GAME_START";
         msg["firstTurn"] = (firstTurn == 1) ? "player1" : "player2";
+        msg["roomCode"] = roomCode;
+        msg["reconnectToken"] = reconnectToken;
+        return msg.dump();
+    }
+    
+    // Соединение снова привязано к месту в сессии
+    static std::string resumed(const std::string& roomCode, const std::string& playerId, uint64_t lastSeq, bool fullSync) {
+        MessageTiming::SerializeScope scope;
+        crow::json::wvalue msg;
+        msg["type"] = "RESUMED";
+        msg["roomCode"] = roomCode;
+        msg["player"] = playerId;
+        msg["lastSeq"] = lastSeq;
+        msg["fullSync"] = fullSync;
+        return msg.dump();
+    }
+    
+    // Комната принадлежит другому шарду: клиенту нужно переподключиться
+    // к /ws?room=<roomCode> и повторить запрос
+    static std::string redirect(const std::string& roomCode) {
+        MessageTiming::SerializeScope scope;
+        crow::json::wvalue msg;
+        msg["type"] = "REDIRECT";
+        msg["roomCode"] = roomCode;
+        return msg.dump();
+    }
+    
+    // Противник вернулся в игру
+    static std::string opponentReconnected() {
+        MessageTiming::SerializeScope scope;
+        crow::json::wvalue msg;
+        msg["type"] = "OPPONENT_RECONNECTED";
         return msg.dump();
     }
     
     // Корабли расставлены
     static std::string shipsPlaced() {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "SHIPS_PLACED";
         return msg.dump();
@@ -32,6 +71,7 @@ public:
     
     // Оба игрока готовы, игра начинается
     static std::string bothPlayersReady() {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "BOTH_PLAYERS_READY";
         msg["message"] = "Оба игрока готовы. Игра начинается!";
@@ -40,6 +80,7 @@ public:
     
     // Состояние после своего выстрела
     static std::string stateMyShot(const Board& board) {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "STATE";
         msg["mode"] = "MY_SHOT";
@@ -80,6 +121,7 @@ public:
     
     // Состояние после выстрела противника
     static std::string stateEnemyShot(const Board& board) {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "STATE";
         msg["mode"] = "ENEMY_SHOT";
@@ -128,6 +170,7 @@ public:
     
     // Конец игры
     static std::string gameOver(const std::string& winner, const PlayerStats& stats) {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "GAME_OVER";
         msg["winner"] = winner;
@@ -143,8 +186,19 @@ public:
         return msg.dump();
     }
     
+    // Сервер останавливается: новые игры не принимаются, текущие
+    // нужно закончить за deadline секунд
+    static std::string serverDraining(unsigned deadline) {
+        MessageTiming::SerializeScope scope;
+        crow::json::wvalue msg;
+        msg["type"] = "SERVER_DRAINING";
+        msg["deadline"] = deadline;
+        return msg.dump();
+    }
+    
     // Ошибка
     static std::string error(const std::string& message) {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "ERROR";
         msg["message"] = message;
@@ -153,6 +207,7 @@ public:
     
     // Pong для heartbeat
     static std::string pong() {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "PONG";
         return msg.dump();
@@ -160,6 +215,7 @@ public:
     
     // Уведомление о том, что сейчас ваш ход
     static std::string yourTurn() {
+        MessageTiming::SerializeScope scope;
         crow::json::wvalue msg;
         msg["type"] = "YOUR_TURN";
         return msg.dump();
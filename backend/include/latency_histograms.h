@@ -0,0 +1,232 @@
+#pragma once
+
+#include "metrics.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Гистограмма задержек в наносекундах по образцу HdrHistogram: каждый
+// интервал [2^k, 2^(k+1)) делится на 16 равных частей, поэтому процентиль
+// завышается не больше чем на 1/16, а запись - это сдвиги и одно сложение
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr size_t kSubBuckets = size_t(1) << kSubBits;
+    // 2^36 нс - около 69 секунд, более долгие значения попадают в последний интервал
+    static constexpr int kMaxExponent = 36;
+    static constexpr size_t kBucketCount = kSubBuckets + (kMaxExponent - kSubBits) * kSubBuckets;
+
+    static size_t bucketOf(uint64_t ns) {
+        if (ns < kSubBuckets) {
+            return static_cast<size_t>(ns);
+        }
+        int exponent = 63 - __builtin_clzll(ns);
+        if (exponent >= kMaxExponent) {
+            return kBucketCount - 1;
+        }
+        size_t sub = static_cast<size_t>(ns >> (exponent - kSubBits)) & (kSubBuckets - 1);
+        return kSubBuckets + static_cast<size_t>(exponent - kSubBits) * kSubBuckets + sub;
+    }
+
+    // Наибольшее значение, попадающее в интервал
+    static uint64_t upperBound(size_t bucket) {
+        if (bucket < kSubBuckets) {
+            return bucket;
+        }
+        size_t exponent = (bucket - kSubBuckets) / kSubBuckets + kSubBits;
+        size_t sub = (bucket - kSubBuckets) % kSubBuckets;
+        uint64_t width = uint64_t(1) << (exponent - kSubBits);
+        return (uint64_t(1) << exponent) + (sub + 1) * width - 1;
+    }
+
+    uint64_t count() const { return total_; }
+
+    // Значение, не больше которого q-я доля записей (q от 0 до 1)
+    uint64_t percentile(double q) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(q * total_ + 0.5);
+        rank = rank == 0 ? 1 : rank;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return upperBound(i);
+            }
+        }
+        return upperBound(kBucketCount - 1);
+    }
+
+    uint64_t max() const { return percentile(1.0); }
+
+    void add(size_t bucket, uint64_t n) {
+        counts_[bucket] += n;
+        total_ += n;
+    }
+
+    // Разность двух снимков одной гистограммы - записи за период между ними
+    LatencyHistogram& operator-=(const LatencyHistogram& earlier) {
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            counts_[i] -= earlier.counts_[i];
+        }
+        total_ -= earlier.total_;
+        return *this;
+    }
+
+private:
+    std::array<uint64_t, kBucketCount> counts_{};
+    uint64_t total_ = 0;
+};
+
+// Время обработки входящих сообщений по типу и этапу.
+// Как и в Metrics, у каждого потока свои гистограммы, в которые пишет только
+// он; они складываются при чтении (HTTP /latency и сводка в журнале)
+class MessageLatency {
+public:
+    enum Phase : size_t {
+        Parse,      // Разбор JSON и определение типа
+        LockWait,   // Ожидание connectionMutex и GameSession::mutex
+        Serialize,  // Сборка ответов в JsonSerializer
+        Handler,    // Вся обработка сообщения, включая этапы выше
+        PhaseCount
+    };
+
+    static const char* phaseName(size_t phase) {
+        static const char* names[PhaseCount] = {"parse", "lockWait", "serialize", "handler"};
+        return names[phase];
+    }
+
+    static void record(size_t type, Phase phase, uint64_t ns) {
+        auto& bucket = localShard().counts[type][phase][LatencyHistogram::bucketOf(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Гистограмма всех потоков с начала работы
+    static LatencyHistogram merged(size_t type, Phase phase) {
+        LatencyHistogram result;
+        auto& registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex_);
+        for (const auto& shard : registry.shards_) {
+            const auto& counts = shard->counts[type][phase];
+            for (size_t i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+                uint64_t n = counts[i].load(std::memory_order_relaxed);
+                if (n != 0) {
+                    result.add(i, n);
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::array<std::array<std::atomic<uint64_t>, LatencyHistogram::kBucketCount>, PhaseCount>,
+                   Metrics::kMessageTypeCount> counts{};
+    };
+
+    static MessageLatency& instance() {
+        static MessageLatency latency;
+        return latency;
+    }
+
+    static Shard& localShard() {
+        thread_local Shard* shard = nullptr;
+        if (!shard) {
+            auto& registry = instance();
+            std::lock_guard<std::mutex> lock(registry.mutex_);
+            registry.shards_.push_back(std::make_unique<Shard>());
+            shard = registry.shards_.back().get();
+        }
+        return *shard;
+    }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// Замер одного сообщения: создается в начале обработки и записывает этапы
+// в MessageLatency при выходе из обработчика. Ожидание блокировок и сборка
+// ответов добавляются к сообщению, которое обрабатывает текущий поток
+class MessageTiming {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    MessageTiming() : start_(Clock::now()), previous_(current()) {
+        current() = this;
+    }
+
+    ~MessageTiming() {
+        current() = previous_;
+        MessageLatency::record(type_, MessageLatency::Parse, parseNs_);
+        MessageLatency::record(type_, MessageLatency::LockWait, lockWaitNs_);
+        MessageLatency::record(type_, MessageLatency::Serialize, serializeNs_);
+        MessageLatency::record(type_, MessageLatency::Handler, elapsedNs(start_));
+    }
+
+    MessageTiming(const MessageTiming&) = delete;
+    MessageTiming& operator=(const MessageTiming&) = delete;
+
+    // JSON разобран, тип известен. Сообщения, не дошедшие до этой точки,
+    // учитываются как тип "other"
+    void parsed(std::string_view type) {
+        parseNs_ = elapsedNs(start_);
+        type_ = Metrics::messageTypeIndex(type);
+    }
+
+    // Захват мьютекса с учетом времени ожидания. Свободный мьютекс
+    // захватывается без обращения к часам
+    static std::unique_lock<std::mutex> lock(std::mutex& mutex) {
+        std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            auto waitStart = Clock::now();
+            lock.lock();
+            if (current()) {
+                current()->lockWaitNs_ += elapsedNs(waitStart);
+            }
+        }
+        return lock;
+    }
+
+    // Время сборки ответа: объявляется в начале метода JsonSerializer
+    class SerializeScope {
+    public:
+        SerializeScope() : timing_(current()) {
+            if (timing_) {
+                start_ = Clock::now();
+            }
+        }
+        ~SerializeScope() {
+            if (timing_) {
+                timing_->serializeNs_ += elapsedNs(start_);
+            }
+        }
+
+    private:
+        MessageTiming* timing_;
+        Clock::time_point start_;
+    };
+
+private:
+    static MessageTiming*& current() {
+        thread_local MessageTiming* timing = nullptr;
+        return timing;
+    }
+
+    static uint64_t elapsedNs(Clock::time_point since) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+    }
+
+    Clock::time_point start_;
+    MessageTiming* previous_;
+    size_t type_ = Metrics::MessagesOther - Metrics::MessagesCreateSession;
+    uint64_t parseNs_ = 0;
+    uint64_t lockWaitNs_ = 0;
+    uint64_t serializeNs_ = 0;
+};
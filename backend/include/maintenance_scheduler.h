@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <crow/logging.h>
+#include <string>
+#include <vector>
+
+// Планировщик периодических задач обслуживания (очистка сессий, статистика,
+// сжатие журнала). Сам потоков не создает: tick() вызывается таймером
+// io_context сервера (app.tick), поэтому задачи выполняются в потоке приема
+// соединений, не занимают рабочие потоки и останавливаются вместе с сервером.
+class MaintenanceScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+    // Добавить задачу с интервалом запуска (0 - задача отключена)
+    void every(const std::string& name, std::chrono::milliseconds interval, Task task) {
+        if (interval.count() <= 0) {
+            return;
+        }
+        tasks.push_back({name, interval, std::move(task), Clock::now() + interval});
+    }
+
+    // Период таймера: самый короткий интервал задач, но не больше секунды,
+    // чтобы задачи запускались с точностью до секунды
+    std::chrono::milliseconds resolution() const {
+        std::chrono::milliseconds result(1000);
+        for (const auto& task : tasks) {
+            result = std::min(result, task.interval);
+        }
+        return result;
+    }
+
+    // Запустить задачи, время которых подошло. Исключение задачи не должно
+    // остановить таймер сервера, поэтому оно только логируется
+    void tick() {
+        auto now = Clock::now();
+        for (auto& task : tasks) {
+            if (now < task.nextRun) {
+                continue;
+            }
+            try {
+                task.run();
+            } catch (const std::exception& e) {
+                CROW_LOG_ERROR << "[Maintenance] Task " << task.name << " failed: " << e.what();
+            }
+            // Отсчет от текущего момента: пропущенные запуски не накапливаются
+            task.nextRun = Clock::now() + task.interval;
+        }
+    }
+
+private:
+    struct ScheduledTask {
+        std::string name;
+        std::chrono::milliseconds interval;
+        Task run;
+        Clock::time_point nextRun;
+    };
+
+    std::vector<ScheduledTask> tasks;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Пределы размера входящих сообщений по их типу.
+// Тип определяется по полю "type" без разбора JSON, поэтому слишком большое
+// сообщение отклоняется до crow::json::load и до захвата блокировок.
+// Общий предел (wsMaxPayload) проверяется раньше, при чтении кадра.
+class MessageLimits {
+public:
+    // Наибольший допустимый размер сообщения данного типа в байтах
+    static size_t maxSize(std::string_view type) {
+        // 10 кораблей из 20 клеток с запасом на пробелы и порядок полей
+        if (type == "PLACE_SHIPS") {
+            return 4096;
+        }
+        // Токен переподключения и номер последнего сообщения
+        if (type == "RESUME") {
+            return 512;
+        }
+        // SHOT, ACK, PING, CREATE_SESSION, JOIN_SESSION и неизвестные типы
+        return 256;
+    }
+
+    // Значение поля "type" верхнего уровня без разбора JSON.
+    // Учитываются только ключи самого объекта: "type" во вложенных объектах
+    // и внутри строковых значений пропускается. Пустая строка, если поле не
+    // найдено: тогда применяется общий предел неизвестного типа.
+    static std::string_view peekType(std::string_view data) {
+        int depth = 0;
+        for (size_t pos = 0; pos < data.size(); ++pos) {
+            char c = data[pos];
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                --depth;
+            } else if (c == '"') {
+                size_t end = stringEnd(data, pos);
+                if (end == std::string_view::npos) {
+                    return {};
+                }
+                // Ключ объекта верхнего уровня: строка на глубине 1, за которой идет ':'
+                size_t next = skipSpaces(data, end + 1);
+                if (depth == 1 && next < data.size() && data[next] == ':' &&
+                    data.substr(pos + 1, end - pos - 1) == "type") {
+                    size_t value = skipSpaces(data, next + 1);
+                    if (value >= data.size() || data[value] != '"') {
+                        return {};
+                    }
+                    size_t valueEnd = stringEnd(data, value);
+                    if (valueEnd == std::string_view::npos) {
+                        return {};
+                    }
+                    return data.substr(value + 1, valueEnd - value - 1);
+                }
+                pos = end;
+            }
+        }
+        return {};
+    }
+
+    // Проверка перед разбором: true, если сообщение помещается в предел своего типа
+    static bool fits(std::string_view data) {
+        if (data.size() <= maxSize({})) {
+            return true;
+        }
+        return data.size() <= maxSize(peekType(data));
+    }
+
+private:
+    // Позиция закрывающей кавычки строки, которая начинается в start, с учетом экранирования
+    static size_t stringEnd(std::string_view data, size_t start) {
+        for (size_t pos = start + 1; pos < data.size(); ++pos) {
+            if (data[pos] == '\\') {
+                ++pos;
+            } else if (data[pos] == '"') {
+                return pos;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    static size_t skipSpaces(std::string_view data, size_t pos) {
+        while (pos < data.size() && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n' || data[pos] == '\r')) {
+            ++pos;
+        }
+        return pos;
+    }
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Счетчики игры для /metrics.
+// Каждый поток пишет в свой шард, поэтому обработчики сообщений не делят
+// между собой ни блокировок, ни строк кэша. Шарды складываются только при
+// чтении (раз в период опроса Prometheus).
+class Metrics {
+public:
+    enum Counter : size_t {
+        // Входящие сообщения по типу
+        MessagesCreateSession,
+        MessagesJoinSession,
+        MessagesResume,
+        MessagesAck,
+        MessagesPlaceShips,
+        MessagesShot,
+        MessagesPing,
+        MessagesOther,
+        // Жизненный цикл сессий
+        SessionsCreated,
+        SessionsJoined,
+        SessionsResumed,
+        SessionsExpired,
+        // Отклоненные сообщения
+        ErrorsInvalidJson,
+        ErrorsOversized,
+        ErrorsBinary,
+        ErrorsUnknownType,
+        ErrorsNoSession,
+        ErrorsJoinFailed,
+        ErrorsException,
+        CounterCount
+    };
+
+    static void add(Counter counter, uint64_t n = 1) {
+        auto& value = localShard().values[counter];
+        // В шард пишет только его поток: атомарное сложение с блокировкой не нужно
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // Сумма по всем потокам. Значения потоков читаются не одновременно,
+    // для счетчиков Prometheus этого достаточно
+    static uint64_t total(Counter counter) {
+        auto& registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex_);
+        uint64_t sum = 0;
+        for (const auto& shard : registry.shards_) {
+            sum += shard->values[counter].load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    // Типы сообщений идут в Counter подряд, с MessagesCreateSession по MessagesOther
+    static constexpr size_t kMessageTypeCount = MessagesOther - MessagesCreateSession + 1;
+    
+    static const char* messageTypeName(size_t index) {
+        static const char* names[kMessageTypeCount] = {
+            "CREATE_SESSION", "JOIN_SESSION", "RESUME", "ACK", "PLACE_SHIPS", "SHOT", "PING", "other"};
+        return names[index];
+    }
+    
+    // Номер типа сообщения от 0 до kMessageTypeCount - 1
+    static size_t messageTypeIndex(std::string_view type) {
+        return messageCounter(type) - MessagesCreateSession;
+    }
+
+    static Counter messageCounter(std::string_view type) {
+        if (type == "CREATE_SESSION") return MessagesCreateSession;
+        if (type == "JOIN_SESSION") return MessagesJoinSession;
+        if (type == "RESUME") return MessagesResume;
+        if (type == "ACK") return MessagesAck;
+        if (type == "PLACE_SHIPS") return MessagesPlaceShips;
+        if (type == "SHOT") return MessagesShot;
+        if (type == "PING") return MessagesPing;
+        return MessagesOther;
+    }
+
+private:
+    // Шард занимает целые строки кэша, чтобы соседние потоки не мешали друг другу
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, CounterCount> values{};
+    };
+
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    // Шард создается при первой записи потока и живет до конца процесса:
+    // значения завершившихся потоков остаются в сумме
+    static Shard& localShard() {
+        thread_local Shard* shard = nullptr;
+        if (!shard) {
+            auto& registry = instance();
+            std::lock_guard<std::mutex> lock(registry.mutex_);
+            registry.shards_.push_back(std::make_unique<Shard>());
+            shard = registry.shards_.back().get();
+        }
+        return *shard;
+    }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// Текстовый формат Prometheus
+class MetricsText {
+public:
+    // Заголовок метрики: type - "counter" или "gauge"
+    void family(std::string_view name, std::string_view type, std::string_view help) {
+        text_.append("# HELP ").append(name).append(" ").append(help).append("\n");
+        text_.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+
+    // Значение; labels - готовая строка вида key="value"
+    void sample(std::string_view name, uint64_t value, std::string_view labels = {}) {
+        text_.append(name);
+        if (!labels.empty()) {
+            text_.append("{").append(labels).append("}");
+        }
+        text_.append(" ").append(std::to_string(value)).append("\n");
+    }
+
+    const std::string& str() const { return text_; }
+
+private:
+    std::string text_;
+};
@@ -0,0 +1,568 @@
+#pragma once
+
+#include <crow.h>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef CROW_USE_BOOST
+namespace asio = boost::asio;
+#endif
+
+// Связь между узлами (процессами) backend.
+//
+// Если игрок попал на узел, которому его комната не принадлежит, этот узел
+// пересылает сообщения игрока узлу-владельцу, а ответы владельца отдает
+// клиенту. На узле-владельце такой игрок представлен RemoteConnection и
+// обрабатывается теми же обработчиками, что и обычный WebSocket.
+//
+// Узлы соединены обычным TCP (TCP_NODELAY), по одному соединению на пару.
+// Кадр: [u32 длина][u8 тип][u64 id соединения][данные], длина считается от
+// байта типа. Первым кадром исходящее соединение шлет HELLO с общим секретом
+// узлов, входящее без верного HELLO закрывается до разбора остальных кадров. Запросы не ждут ответов, а все кадры, накопившиеся за время
+// предыдущей записи, уходят в сокет одним вызовом write.
+// Весь сетевой ввод-вывод и обработка пересланных сообщений идут в одном
+// потоке связи.
+class NodeLink {
+public:
+    using MessageHandler = crow::websocket::message_handler_type;
+    using CloseHandler = std::function<void(crow::websocket::connection&, const std::string&, uint16_t)>;
+
+    NodeLink() = default;
+    NodeLink(const NodeLink&) = delete;
+    NodeLink& operator=(const NodeLink&) = delete;
+
+    ~NodeLink() {
+        stop();
+    }
+
+    // Запустить связь: прием соединений на bindAddress:port и адреса узлов
+    // peers[i] = "host:port" для шарда i (адрес самого узла с индексом selfIndex
+    // не используется). secret - общий для всех узлов секрет рукопожатия
+    bool start(const std::string& bindAddress, uint16_t port, const std::string& secret, unsigned selfIndex,
+               const std::vector<std::string>& peers, MessageHandler onMessage, CloseHandler onClose) {
+        onMessage_ = std::move(onMessage);
+        onClose_ = std::move(onClose);
+        secret_ = secret;
+        selfIndex_ = selfIndex;
+        peerAddresses_ = peers;
+        outbound_.assign(peers.size(), nullptr);
+
+        try {
+            acceptor_ = std::make_unique<crow::tcp::acceptor>(io_);
+            crow::tcp::endpoint endpoint(asio::ip::make_address(bindAddress), port);
+            acceptor_->open(endpoint.protocol());
+            acceptor_->set_option(asio::socket_base::reuse_address(true));
+            acceptor_->bind(endpoint);
+            acceptor_->listen();
+        } catch (const std::exception& e) {
+            CROW_LOG_ERROR << "[Link] Cannot listen on " << bindAddress << ":" << port << ": " << e.what();
+            acceptor_.reset();
+            return false;
+        }
+
+        work_ = std::make_unique<WorkGuard>(io_.get_executor());
+        doAccept();
+        thread_ = std::thread([this] {
+#ifdef __linux__
+            pthread_setname_np(pthread_self(), "sb-link");
+#endif
+            io_.run();
+        });
+        enabled_ = true;
+
+        CROW_LOG_INFO << "[Link] Listening on " << bindAddress << ":" << port << ", " << peers.size() << " peers";
+        return true;
+    }
+
+    void stop() {
+        if (!enabled_.exchange(false)) {
+            return;
+        }
+        asio::post(io_, [this] {
+            crow::error_code ec;
+            acceptor_->close(ec);
+            std::vector<std::shared_ptr<Channel>> channels;
+            {
+                std::lock_guard<std::mutex> lock(outboundMutex_);
+                for (auto& channel : outbound_) {
+                    if (channel) channels.push_back(channel);
+                }
+            }
+            for (auto& [ptr, channel] : inbound_) {
+                channels.push_back(channel);
+            }
+            for (auto& channel : channels) {
+                channel->shutdown();
+            }
+        });
+        work_.reset();
+        thread_.join();
+    }
+
+    bool isEnabled() const {
+        return enabled_;
+    }
+
+    // Знает ли этот узел адрес узла шарда
+    bool canForward(unsigned shard) const {
+        return enabled_ && shard != selfIndex_ && shard < peerAddresses_.size() && !peerAddresses_[shard].empty();
+    }
+
+    // Начать пересылку локального соединения узлу шарда
+    void attach(crow::websocket::connection& conn, unsigned shard) {
+        std::shared_ptr<Channel> channel;
+        {
+            std::lock_guard<std::mutex> lock(outboundMutex_);
+            channel = outbound_[shard];
+            if (!channel || channel->isClosed()) {
+                channel = std::make_shared<Channel>(*this, true);
+                outbound_[shard] = channel;
+                // Очередь пуста до подключения, поэтому HELLO уйдет первым
+                channel->send(FrameType::HELLO, 0, secret_);
+                connect(channel, peerAddresses_[shard]);
+            }
+        }
+
+        uint64_t id = nextId_++;
+        {
+            std::lock_guard<std::mutex> lock(routesMutex_);
+            routes_[&conn] = Route{channel, id};
+            locals_[id] = &conn;
+        }
+        channel->send(FrameType::OPEN, id, conn.get_remote_ip());
+    }
+
+    // Переслать сообщение, если соединение пересылается (false - обработать локально)
+    bool forward(crow::websocket::connection& conn, const std::string& data, bool isBinary) {
+        std::lock_guard<std::mutex> lock(routesMutex_);
+        auto it = routes_.find(&conn);
+        if (it == routes_.end()) {
+            return false;
+        }
+        it->second.channel->send(isBinary ? FrameType::BINARY : FrameType::TEXT, it->second.id, data);
+        return true;
+    }
+
+    // Пересылается ли соединение другому узлу
+    bool isForwarded(crow::websocket::connection& conn) {
+        std::lock_guard<std::mutex> lock(routesMutex_);
+        return routes_.count(&conn) > 0;
+    }
+
+    // Локальное соединение закрылось (false - оно не пересылалось)
+    bool detach(crow::websocket::connection& conn) {
+        std::lock_guard<std::mutex> lock(routesMutex_);
+        auto it = routes_.find(&conn);
+        if (it == routes_.end()) {
+            return false;
+        }
+        it->second.channel->send(FrameType::CLOSE, it->second.id, encodeClose(crow::websocket::NormalClosure, "client closed"));
+        locals_.erase(it->second.id);
+        routes_.erase(it);
+        return true;
+    }
+
+private:
+    enum class FrameType : uint8_t {
+        OPEN = 1,   // Новый клиент (данные - его IP)
+        TEXT = 2,   // Текстовое сообщение клиенту или от клиента
+        BINARY = 3, // Бинарное сообщение
+        CLOSE = 4,  // Закрытие соединения (данные - u16 код и причина)
+        HELLO = 5   // Рукопожатие (данные - общий секрет узлов)
+    };
+
+    static constexpr size_t kHeaderSize = 4 + 1 + 8;
+    static constexpr size_t kMaxFrameSize = 16 * 1024 * 1024;
+    // До рукопожатия большие кадры не буферизуются
+    static constexpr size_t kMaxHelloSize = 1024;
+
+    using WorkGuard = asio::executor_work_guard<asio::io_context::executor_type>;
+
+    // TCP соединение с другим узлом
+    class Channel : public std::enable_shared_from_this<Channel> {
+    public:
+        Channel(NodeLink& link, bool outbound):
+          link_(link), socket_(link.io_), outbound_(outbound), authenticated_(outbound)
+        {}
+
+        crow::tcp::socket& socket() { return socket_; }
+        bool isOutbound() const { return outbound_; }
+
+        bool isClosed() {
+            std::lock_guard<std::mutex> lock(writeMutex_);
+            return closed_;
+        }
+
+        // Поставить кадр в очередь (из любого потока)
+        void send(FrameType type, uint64_t id, const std::string& payload) {
+            std::lock_guard<std::mutex> lock(writeMutex_);
+            if (closed_) {
+                return;
+            }
+
+            uint32_t length = static_cast<uint32_t>(1 + 8 + payload.size());
+            size_t offset = pending_.size();
+            pending_.resize(offset + kHeaderSize);
+            std::memcpy(&pending_[offset], &length, 4);
+            pending_[offset + 4] = static_cast<char>(type);
+            std::memcpy(&pending_[offset + 5], &id, 8);
+            pending_ += payload;
+
+            if (connected_ && !writing_) {
+                writing_ = true;
+                asio::post(link_.io_, [self = shared_from_this()] { self->flush(); });
+            }
+        }
+
+        // Соединение установлено (поток связи)
+        void onConnected() {
+            crow::error_code ec;
+            socket_.set_option(crow::tcp::no_delay(true), ec);
+            {
+                std::lock_guard<std::mutex> lock(writeMutex_);
+                connected_ = true;
+                if (!pending_.empty() && !writing_) {
+                    writing_ = true;
+                    asio::post(link_.io_, [self = shared_from_this()] { self->flush(); });
+                }
+            }
+            doRead();
+        }
+
+        // Закрыть соединение (поток связи)
+        void shutdown() {
+            {
+                std::lock_guard<std::mutex> lock(writeMutex_);
+                if (closed_) {
+                    return;
+                }
+                closed_ = true;
+                pending_.clear();
+            }
+            crow::error_code ec;
+            socket_.shutdown(crow::tcp::socket::shutdown_both, ec);
+            socket_.close(ec);
+            link_.onChannelClosed(this);
+        }
+
+    private:
+        // Отправить все накопленные кадры одной записью
+        void flush() {
+            {
+                std::lock_guard<std::mutex> lock(writeMutex_);
+                if (closed_ || pending_.empty()) {
+                    writing_ = false;
+                    return;
+                }
+                sending_.swap(pending_);
+            }
+            asio::async_write(
+              socket_, asio::buffer(sending_),
+              [self = shared_from_this()](const crow::error_code& ec, std::size_t) {
+                  self->sending_.clear();
+                  if (ec) {
+                      self->shutdown();
+                      return;
+                  }
+                  self->flush();
+              });
+        }
+
+        void doRead() {
+            socket_.async_read_some(
+              asio::buffer(readBuffer_),
+              [self = shared_from_this()](const crow::error_code& ec, std::size_t bytes) {
+                  if (ec) {
+                      self->shutdown();
+                      return;
+                  }
+                  self->inbox_.append(self->readBuffer_.data(), bytes);
+                  if (!self->parseFrames()) {
+                      self->shutdown();
+                      return;
+                  }
+                  self->doRead();
+              });
+        }
+
+        // Разбор всех полностью полученных кадров
+        bool parseFrames() {
+            size_t offset = 0;
+            while (inbox_.size() - offset >= kHeaderSize) {
+                uint32_t length;
+                std::memcpy(&length, inbox_.data() + offset, 4);
+                if (length < 9 || length > (authenticated_ ? kMaxFrameSize : kMaxHelloSize)) {
+                    CROW_LOG_ERROR << "[Link] Invalid frame length " << length;
+                    return false;
+                }
+                if (inbox_.size() - offset < 4 + static_cast<size_t>(length)) {
+                    break;
+                }
+
+                auto type = static_cast<FrameType>(inbox_[offset + 4]);
+                uint64_t id;
+                std::memcpy(&id, inbox_.data() + offset + 5, 8);
+                std::string payload = inbox_.substr(offset + kHeaderSize, length - 9);
+                offset += 4 + length;
+
+                if (!authenticated_) {
+                    if (type != FrameType::HELLO || !link_.secretMatches(payload)) {
+                        CROW_LOG_WARNING << "[Link] Rejected node " << remoteAddress() << ": bad handshake";
+                        return false;
+                    }
+                    authenticated_ = true;
+                    continue;
+                }
+                link_.onFrame(*this, type, id, std::move(payload));
+            }
+            inbox_.erase(0, offset);
+            return true;
+        }
+
+        std::string remoteAddress() {
+            crow::error_code ec;
+            auto endpoint = socket_.remote_endpoint(ec);
+            return ec ? std::string("unknown") : endpoint.address().to_string();
+        }
+
+        NodeLink& link_;
+        crow::tcp::socket socket_;
+        bool outbound_;
+        bool authenticated_;  // Входящее соединение прислало верный HELLO (поток связи)
+
+        std::mutex writeMutex_;
+        std::string pending_;  // Кадры, ожидающие записи
+        std::string sending_;  // Кадры текущей записи
+        bool connected_ = false;
+        bool writing_ = false;
+        bool closed_ = false;
+
+        std::array<char, 64 * 1024> readBuffer_;
+        std::string inbox_;
+    };
+
+    // Клиент другого узла, представленный на узле-владельце комнаты
+    class RemoteConnection : public crow::websocket::connection {
+    public:
+        RemoteConnection(std::shared_ptr<Channel> channel, uint64_t id, std::string remoteIp):
+          channel_(std::move(channel)), id_(id), remoteIp_(std::move(remoteIp))
+        {
+            userdata(nullptr);
+        }
+
+        void send_binary(std::string msg) override {
+            channel_->send(FrameType::BINARY, id_, msg);
+        }
+
+        void send_text(std::string msg) override {
+            channel_->send(FrameType::TEXT, id_, msg);
+        }
+
+        // Ping/pong обслуживает узел, к которому подключен клиент
+        void send_ping(std::string) override {}
+        void send_pong(std::string) override {}
+
+        void close(std::string const& msg, uint16_t status_code) override {
+            channel_->send(FrameType::CLOSE, id_, encodeClose(status_code, msg));
+        }
+
+        std::string get_remote_ip() override {
+            return remoteIp_;
+        }
+
+        std::string get_subprotocol() const override {
+            return {};
+        }
+
+    private:
+        std::shared_ptr<Channel> channel_;
+        uint64_t id_;
+        std::string remoteIp_;
+    };
+
+    // Локальное соединение, пересылаемое другому узлу
+    struct Route {
+        std::shared_ptr<Channel> channel;
+        uint64_t id;
+    };
+
+    static std::string encodeClose(uint16_t code, const std::string& reason) {
+        std::string payload(2, '\0');
+        std::memcpy(&payload[0], &code, 2);
+        return payload + reason;
+    }
+
+    static void decodeClose(const std::string& payload, uint16_t& code, std::string& reason) {
+        code = crow::websocket::NormalClosure;
+        if (payload.size() >= 2) {
+            std::memcpy(&code, payload.data(), 2);
+            reason = payload.substr(2);
+        }
+    }
+
+    // Сравнение секрета за время, не зависящее от совпавшего префикса
+    bool secretMatches(const std::string& secret) const {
+        if (secret.size() != secret_.size()) {
+            return false;
+        }
+        unsigned char diff = 0;
+        for (size_t i = 0; i < secret.size(); ++i) {
+            diff |= static_cast<unsigned char>(secret[i] ^ secret_[i]);
+        }
+        return diff == 0;
+    }
+
+    void doAccept() {
+        auto channel = std::make_shared<Channel>(*this, false);
+        acceptor_->async_accept(channel->socket(), [this, channel](const crow::error_code& ec) {
+            if (ec) {
+                return; // Прием остановлен
+            }
+            remotes_[channel.get()];
+            inbound_[channel.get()] = channel;
+            channel->onConnected();
+            doAccept();
+        });
+    }
+
+    void connect(const std::shared_ptr<Channel>& channel, const std::string& address) {
+        asio::post(io_, [this, channel, address] {
+            auto colon = address.rfind(':');
+            crow::error_code ec;
+            crow::tcp::resolver resolver(io_);
+            auto endpoints = resolver.resolve(address.substr(0, colon), address.substr(colon + 1), ec);
+            if (ec) {
+                CROW_LOG_ERROR << "[Link] Cannot resolve " << address << ": " << ec.message();
+                channel->shutdown();
+                return;
+            }
+            asio::async_connect(channel->socket(), endpoints,
+                                      [this, channel, address](const crow::error_code& ec, const crow::tcp::endpoint&) {
+                                          if (ec) {
+                                              CROW_LOG_ERROR << "[Link] Cannot connect to " << address << ": " << ec.message();
+                                              channel->shutdown();
+                                              return;
+                                          }
+                                          CROW_LOG_INFO << "[Link] Connected to " << address;
+                                          channel->onConnected();
+                                      });
+        });
+    }
+
+    // Обработка кадра (поток связи)
+    void onFrame(Channel& channel, FrameType type, uint64_t id, std::string payload) {
+        if (channel.isOutbound()) {
+            // Ответ узла-владельца нашему клиенту
+            std::lock_guard<std::mutex> lock(routesMutex_);
+            auto it = locals_.find(id);
+            if (it == locals_.end()) {
+                return; // Клиент уже отключился
+            }
+            switch (type) {
+                case FrameType::TEXT:
+                    it->second->send_text(std::move(payload));
+                    break;
+                case FrameType::BINARY:
+                    it->second->send_binary(std::move(payload));
+                    break;
+                case FrameType::CLOSE: {
+                    // Маршрут удалится в detach, когда соединение закроется
+                    uint16_t code;
+                    std::string reason;
+                    decodeClose(payload, code, reason);
+                    it->second->close(reason, code);
+                    break;
+                }
+                default:
+                    break;
+            }
+            return;
+        }
+
+        // Сообщение клиента другого узла в нашу комнату
+        auto& remotes = remotes_[&channel];
+        switch (type) {
+            case FrameType::OPEN:
+                remotes[id] = std::make_unique<RemoteConnection>(inbound_[&channel], id, payload);
+                break;
+            case FrameType::TEXT:
+            case FrameType::BINARY: {
+                auto it = remotes.find(id);
+                if (it != remotes.end()) {
+                    onMessage_(*it->second, payload, type == FrameType::BINARY);
+                }
+                break;
+            }
+            case FrameType::CLOSE: {
+                auto it = remotes.find(id);
+                if (it != remotes.end()) {
+                    uint16_t code;
+                    std::string reason;
+                    decodeClose(payload, code, reason);
+                    onClose_(*it->second, reason, code);
+                    remotes.erase(it);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // Соединение с узлом разорвано (поток связи)
+    void onChannelClosed(Channel* channel) {
+        if (channel->isOutbound()) {
+            // Клиенты, чьи комнаты живут на том узле, переподключатся через RESUME
+            std::lock_guard<std::mutex> lock(routesMutex_);
+            for (auto& [conn, route] : routes_) {
+                if (route.channel.get() == channel) {
+                    conn->close("Узел комнаты недоступен", crow::websocket::EndpointGoingAway);
+                }
+            }
+            return;
+        }
+
+        auto it = remotes_.find(channel);
+        if (it != remotes_.end()) {
+            for (auto& [id, remote] : it->second) {
+                onClose_(*remote, "node link closed", crow::websocket::ClosedAbnormally);
+            }
+            remotes_.erase(it);
+        }
+        inbound_.erase(channel);
+    }
+
+    asio::io_context io_;
+    std::unique_ptr<WorkGuard> work_;
+    std::unique_ptr<crow::tcp::acceptor> acceptor_;
+    std::thread thread_;
+    std::atomic<bool> enabled_{false};
+
+    MessageHandler onMessage_;
+    CloseHandler onClose_;
+    std::string secret_;
+    unsigned selfIndex_ = 0;
+    std::vector<std::string> peerAddresses_;
+
+    // Исходящие соединения к узлам-владельцам, по номеру шарда
+    std::mutex outboundMutex_;
+    std::vector<std::shared_ptr<Channel>> outbound_;
+
+    // Пересылаемые локальные соединения
+    std::mutex routesMutex_;
+    std::unordered_map<crow::websocket::connection*, Route> routes_;
+    std::unordered_map<uint64_t, crow::websocket::connection*> locals_;
+    std::atomic<uint64_t> nextId_{1};
+
+    // Входящие соединения и их клиенты (только поток связи)
+    std::unordered_map<Channel*, std::shared_ptr<Channel>> inbound_;
+    std::unordered_map<Channel*, std::unordered_map<uint64_t, std::unique_ptr<RemoteConnection>>> remotes_;
+};
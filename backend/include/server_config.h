@@ -0,0 +1,367 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+// Конфигурация backend сервера.
+// Каждый параметр задается аргументом командной строки вида --name=value
+// или переменной окружения SEA_BATTLE_NAME (аргумент имеет приоритет).
+struct ServerConfig {
+    uint16_t port = 18080;
+    // Unix socket вместо TCP порта (пусто - слушать port) и права на файл
+    // сокета в восьмеричной записи: nginx на той же машине подключается к нему
+    // без стека TCP/IP
+    std::string unixSocket;
+    unsigned unixSocketMode = 0660;
+
+    // Число потоков сервера вместе с потоком приема соединений
+    // (0 - по числу ядер)
+    unsigned threads = 0;
+    // Ядра для привязки рабочих потоков по кругу, например "0-3,6"
+    // (пусто - без привязки)
+    std::vector<int> cpuAffinity;
+
+    // Предел очереди отправки одного WebSocket соединения (0 - без предела):
+    // клиент, который не успевает читать, отключается с кодом 1008
+    uint64_t wsSendQueueBytes = 1024 * 1024;
+    size_t wsSendQueueMessages = 256;
+    // Ping от сервера раз в wsPingInterval секунд (0 - отключен); соединение,
+    // не ответившее на wsPingMisses пингов подряд, считается оборванным
+    unsigned wsPingInterval = 10;
+    unsigned wsPingMisses = 3;
+    // Предел размера входящего сообщения в байтах (0 - без предела)
+    uint64_t wsMaxPayload = 4096;
+    // Входящих сообщений в секунду на соединение и допустимый всплеск
+    // (0 - без ограничения); лишние сообщения отбрасываются, а после
+    // wsRateMaxDropped отброшенных подряд соединение закрывается (0 - никогда)
+    double wsRateLimit = 20;
+    double wsRateBurst = 40;
+    unsigned wsRateMaxDropped = 50;
+
+    // Параметры TCP принятых соединений (0 - значение системы):
+    // TCP_NODELAY, TCP_QUICKACK (1 - включить), SO_BUSY_POLL в микросекундах,
+    // размеры буферов в байтах, TCP_USER_TIMEOUT в миллисекундах и keepalive
+    // (простой до первой пробы, интервал в секундах, число проб)
+    bool tcpNoDelay = true;
+    bool tcpQuickAck = false;
+    int tcpBusyPoll = 0;
+    int tcpSendBuffer = 0;
+    int tcpReceiveBuffer = 0;
+    unsigned tcpUserTimeout = 0;
+    unsigned tcpKeepaliveIdle = 0;
+    unsigned tcpKeepaliveInterval = 10;
+    unsigned tcpKeepaliveCount = 3;
+
+    // Отдельный SO_REUSEPORT сокет приема у каждого рабочего потока:
+    // соединения распределяет ядро, и их принимает тот поток, что обслуживает
+    bool reusePort = false;
+
+    // Шардирование комнат между процессами: первый символ кода комнаты
+    // (hex цифра) - номер процесса-владельца, поэтому шардов не больше 16
+    unsigned shardIndex = 0;
+    unsigned shardCount = 1;
+
+    // Связь между узлами: адрес и порт приема (0 - связь отключена), общий
+    // секрет рукопожатия и адреса host:port узлов всех шардов по порядку номеров
+    std::string linkBind = "127.0.0.1";
+    uint16_t linkPort = 0;
+    std::string linkSecret;
+    std::vector<std::string> peers;
+
+    // Unix socket для горячего перезапуска (пусто - перезапуск отключен).
+    // Передается один сокет приема, поэтому вместе с reusePort не работает
+    std::string handoffPath;
+
+    // Журнал сессий (пустой путь - журнал отключен)
+    std::string journalPath;
+    // Интервал группового сброса журнала на диск
+    unsigned journalFlushMs = 10;
+    // Размер журнала, после которого он сжимается в снимок
+    uint64_t journalCompactBytes = 64ull * 1024 * 1024;
+    // Периодическое сжатие журнала в секундах (0 - только по размеру)
+    unsigned journalCompactInterval = 0;
+
+    // Двоичная трасса игр (пустой каталог - трасса отключена): размер
+    // одного файла в мегабайтах, сколько последних файлов хранить и
+    // интервал переноса записей в файл
+    std::string traceDir;
+    unsigned traceFileMb = 64;
+    unsigned traceFiles = 16;
+    unsigned traceFlushMs = 100;
+
+    // Время на завершение игр после SIGTERM, секунды (0 - остановка сразу)
+    unsigned drainTimeout = 120;
+
+    // Интервалы задач обслуживания в секундах (0 - задача отключена)
+    unsigned cleanupInterval = 300;
+    unsigned statsInterval = 60;
+
+    // Журнал: уровень (debug, info, warning, error), формат строк (text или
+    // json) и число записей в буфере каждого потока. Записи выводит отдельный
+    // поток; 0 - писать синхронно из потока, который пишет в журнал
+    std::string logLevel = "info";
+    std::string logFormat = "text";
+    unsigned logBuffer = 4096;
+
+    static ServerConfig load(int argc, char** argv) {
+        ServerConfig config;
+
+        if (auto v = option(argc, argv, "port")) {
+            config.port = number<uint16_t>("port", *v);
+        }
+        if (auto v = option(argc, argv, "unix-socket")) {
+            config.unixSocket = *v;
+        }
+        if (auto v = option(argc, argv, "unix-socket-mode")) {
+            config.unixSocketMode = number<unsigned>("unix-socket-mode", *v, 8);
+        }
+        if (auto v = option(argc, argv, "threads")) {
+            config.threads = number<unsigned>("threads", *v);
+        }
+        if (auto v = option(argc, argv, "cpu-affinity")) {
+            config.cpuAffinity = parseCpuList(*v);
+        }
+        if (auto v = option(argc, argv, "ws-send-queue-bytes")) {
+            config.wsSendQueueBytes = number<uint64_t>("ws-send-queue-bytes", *v);
+        }
+        if (auto v = option(argc, argv, "ws-send-queue-messages")) {
+            config.wsSendQueueMessages = number<size_t>("ws-send-queue-messages", *v);
+        }
+        if (auto v = option(argc, argv, "ws-ping-interval")) {
+            config.wsPingInterval = number<unsigned>("ws-ping-interval", *v);
+        }
+        if (auto v = option(argc, argv, "ws-ping-misses")) {
+            config.wsPingMisses = std::max(1u, number<unsigned>("ws-ping-misses", *v));
+        }
+        if (auto v = option(argc, argv, "ws-max-payload")) {
+            config.wsMaxPayload = number<uint64_t>("ws-max-payload", *v);
+        }
+        if (auto v = option(argc, argv, "ws-rate-limit")) {
+            config.wsRateLimit = number<double>("ws-rate-limit", *v);
+        }
+        if (auto v = option(argc, argv, "ws-rate-burst")) {
+            config.wsRateBurst = number<double>("ws-rate-burst", *v);
+        }
+        if (auto v = option(argc, argv, "ws-rate-max-dropped")) {
+            config.wsRateMaxDropped = number<unsigned>("ws-rate-max-dropped", *v);
+        }
+        if (auto v = option(argc, argv, "tcp-nodelay")) {
+            config.tcpNoDelay = number<unsigned>("tcp-nodelay", *v) != 0;
+        }
+        if (auto v = option(argc, argv, "tcp-quickack")) {
+            config.tcpQuickAck = number<unsigned>("tcp-quickack", *v) != 0;
+        }
+        if (auto v = option(argc, argv, "tcp-busy-poll")) {
+            config.tcpBusyPoll = number<int>("tcp-busy-poll", *v);
+        }
+        if (auto v = option(argc, argv, "tcp-send-buffer")) {
+            config.tcpSendBuffer = number<int>("tcp-send-buffer", *v);
+        }
+        if (auto v = option(argc, argv, "tcp-receive-buffer")) {
+            config.tcpReceiveBuffer = number<int>("tcp-receive-buffer", *v);
+        }
+        if (auto v = option(argc, argv, "tcp-user-timeout")) {
+            config.tcpUserTimeout = number<unsigned>("tcp-user-timeout", *v);
+        }
+        if (auto v = option(argc, argv, "tcp-keepalive-idle")) {
+            config.tcpKeepaliveIdle = number<unsigned>("tcp-keepalive-idle", *v);
+        }
+        if (auto v = option(argc, argv, "tcp-keepalive-interval")) {
+            config.tcpKeepaliveInterval = number<unsigned>("tcp-keepalive-interval", *v);
+        }
+        if (auto v = option(argc, argv, "tcp-keepalive-count")) {
+            config.tcpKeepaliveCount = number<unsigned>("tcp-keepalive-count", *v);
+        }
+        if (auto v = option(argc, argv, "reuse-port")) {
+            config.reusePort = number<unsigned>("reuse-port", *v) != 0;
+        }
+        if (auto v = option(argc, argv, "shard-index")) {
+            config.shardIndex = number<unsigned>("shard-index", *v);
+        }
+        if (auto v = option(argc, argv, "shard-count")) {
+            config.shardCount = number<unsigned>("shard-count", *v);
+        }
+        if (config.shardCount < 1 || config.shardCount > 16 || config.shardIndex >= config.shardCount) {
+            throw std::invalid_argument("shard-index must be less than shard-count, shard-count must be 1..16");
+        }
+        if (auto v = option(argc, argv, "link-port")) {
+            config.linkPort = number<uint16_t>("link-port", *v);
+        }
+        if (auto v = option(argc, argv, "link-bind")) {
+            config.linkBind = *v;
+        }
+        if (auto v = option(argc, argv, "link-secret")) {
+            config.linkSecret = *v;
+        }
+        if (auto v = option(argc, argv, "peers")) {
+            config.peers = split(*v, ',');
+        }
+        if (config.linkPort != 0 && config.linkSecret.empty()) {
+            throw std::invalid_argument("link-secret is required when link-port is set");
+        }
+        if (auto v = option(argc, argv, "handoff")) {
+            config.handoffPath = *v;
+        }
+        if (!config.handoffPath.empty() && config.reusePort) {
+            throw std::invalid_argument("handoff cannot be combined with reuse-port");
+        }
+        if (auto v = option(argc, argv, "journal")) {
+            config.journalPath = *v;
+        }
+        if (auto v = option(argc, argv, "journal-flush-ms")) {
+            config.journalFlushMs = number<unsigned>("journal-flush-ms", *v);
+        }
+        if (auto v = option(argc, argv, "journal-compact-bytes")) {
+            config.journalCompactBytes = number<uint64_t>("journal-compact-bytes", *v);
+        }
+        if (auto v = option(argc, argv, "journal-compact-interval")) {
+            config.journalCompactInterval = number<unsigned>("journal-compact-interval", *v);
+        }
+        if (auto v = option(argc, argv, "trace-dir")) {
+            config.traceDir = *v;
+        }
+        if (auto v = option(argc, argv, "trace-file-mb")) {
+            config.traceFileMb = number<unsigned>("trace-file-mb", *v);
+        }
+        if (auto v = option(argc, argv, "trace-files")) {
+            config.traceFiles = number<unsigned>("trace-files", *v);
+        }
+        if (auto v = option(argc, argv, "trace-flush-ms")) {
+            config.traceFlushMs = number<unsigned>("trace-flush-ms", *v);
+        }
+        if (config.traceFileMb == 0 || config.traceFlushMs == 0) {
+            throw std::invalid_argument("trace-file-mb and trace-flush-ms must be positive");
+        }
+        if (auto v = option(argc, argv, "drain-timeout")) {
+            config.drainTimeout = number<unsigned>("drain-timeout", *v);
+        }
+        if (auto v = option(argc, argv, "cleanup-interval")) {
+            config.cleanupInterval = number<unsigned>("cleanup-interval", *v);
+        }
+        if (auto v = option(argc, argv, "stats-interval")) {
+            config.statsInterval = number<unsigned>("stats-interval", *v);
+        }
+        if (auto v = option(argc, argv, "log-level")) {
+            config.logLevel = *v;
+        }
+        if (config.logLevel != "debug" && config.logLevel != "info" && config.logLevel != "warning" &&
+            config.logLevel != "error") {
+            throw std::invalid_argument("log-level must be debug, info, warning or error");
+        }
+        if (auto v = option(argc, argv, "log-format")) {
+            config.logFormat = *v;
+        }
+        if (config.logFormat != "text" && config.logFormat != "json") {
+            throw std::invalid_argument("log-format must be text or json");
+        }
+        if (auto v = option(argc, argv, "log-buffer")) {
+            config.logBuffer = number<unsigned>("log-buffer", *v);
+        }
+
+        return config;
+    }
+
+private:
+    // Число из значения параметра name. Нечисловое значение, лишние символы
+    // и выход за пределы типа T - ошибка с именем параметра, а не усечение
+    template <typename T>
+    static T number(const std::string& name, const std::string& value, int base = 10) {
+        const std::string option = "--" + name + "=" + value;
+        size_t end = 0;
+        T result{};
+        try {
+            if constexpr (std::is_floating_point_v<T>) {
+                result = static_cast<T>(std::stod(value, &end));
+            } else if constexpr (std::is_signed_v<T>) {
+                long long n = std::stoll(value, &end, base);
+                if (n < std::numeric_limits<T>::min() || n > std::numeric_limits<T>::max()) {
+                    throw std::out_of_range(name);
+                }
+                result = static_cast<T>(n);
+            } else {
+                // stoull принимает "-1" и возвращает максимум типа
+                if (value.find('-') != std::string::npos) {
+                    throw std::out_of_range(name);
+                }
+                unsigned long long n = std::stoull(value, &end, base);
+                if (n > std::numeric_limits<T>::max()) {
+                    throw std::out_of_range(name);
+                }
+                result = static_cast<T>(n);
+            }
+        } catch (const std::out_of_range&) {
+            if constexpr (std::is_floating_point_v<T>) {
+                throw std::invalid_argument(option + ": value out of range");
+            } else {
+                throw std::invalid_argument(option + ": value must be between " +
+                                            std::to_string(std::numeric_limits<T>::min()) + " and " +
+                                            std::to_string(std::numeric_limits<T>::max()));
+            }
+        } catch (const std::invalid_argument&) {
+            throw std::invalid_argument(option + ": not a number");
+        }
+        if (end != value.size()) {
+            throw std::invalid_argument(option + ": not a number");
+        }
+        return result;
+    }
+
+    // Список ядер в формате taskset: номера и диапазоны через запятую
+    static std::vector<int> parseCpuList(const std::string& value) {
+        std::vector<int> cpus;
+        for (const auto& part : split(value, ',')) {
+            if (part.empty()) continue;
+            size_t dash = part.find('-');
+            int first = number<int>("cpu-affinity", part.substr(0, dash));
+            int last = dash == std::string::npos ? first : number<int>("cpu-affinity", part.substr(dash + 1));
+            if (first < 0 || last < first) {
+                throw std::invalid_argument("invalid cpu-affinity range: " + part);
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    static std::vector<std::string> split(const std::string& value, char separator) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= value.size()) {
+            size_t end = value.find(separator, start);
+            if (end == std::string::npos) end = value.size();
+            parts.push_back(value.substr(start, end - start));
+            start = end + 1;
+        }
+        return parts;
+    }
+
+    // Поиск значения параметра: сначала --name=value, затем SEA_BATTLE_NAME
+    static std::optional<std::string> option(int argc, char** argv, const std::string& name) {
+        std::string prefix = "--" + name + "=";
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.compare(0, prefix.size(), prefix) == 0) {
+                return arg.substr(prefix.size());
+            }
+        }
+
+        std::string envName = "SEA_BATTLE_" + name;
+        std::transform(envName.begin(), envName.end(), envName.begin(), [](unsigned char c) {
+            return c == '-' ? '_' : static_cast<char>(std::toupper(c));
+        });
+        if (const char* value = std::getenv(envName.c_str())) {
+            return std::string(value);
+        }
+
+        return std::nullopt;
+    }
+};
@@ -0,0 +1,701 @@
+#pragma once
+
+#include "types.h"
+#include "game_engine.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <crow/logging.h>
+#include <thread>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// Журнал событий игровых сессий.
+//
+// Каждое изменение сессии (создание, присоединение, расстановка, выстрел)
+// дописывается в конец файла. Запись происходит в отдельном потоке: игровые
+// потоки только кладут закодированную запись в буфер, а поток журнала пачкой
+// пишет накопленное и делает один fdatasync на всю пачку. Пачка, которую не
+// удалось записать, повторяется при следующем сбросе; после нескольких неудач
+// подряд журнал отключается (isFailed), чтобы не копить события в памяти.
+//
+// Формат записи: [u32 длина тела][u32 crc32 тела][тело]
+// Тело:          [u8 тип][u64 время, мс][u64 номер события][строка код комнаты][данные]
+// CREATE/JOIN хранят токен переподключения и playerId игрока, снимок - playerId
+// в данных игроков и токены в конце. В старых записях полей может не быть.
+//
+// Когда файл разрастается, он сжимается: живые сессии записываются в новый
+// файл снимками (SNAPSHOT), который атомарно заменяет старый. Замена считается
+// состоявшейся только после fsync каталога, до этого старый журнал доступен
+// по ссылке <путь>.old и возвращается на место, если fsync не удался. При старте
+// файл отображается в память и проигрывается: снимок плюс хвост событий.
+// Номер события (GameSession::journalSeq) позволяет пропускать события,
+// которые уже учтены в снимке.
+class SessionJournal {
+public:
+    using SessionsProvider = std::function<std::vector<std::shared_ptr<GameSession>>()>;
+
+    SessionJournal() = default;
+    SessionJournal(const SessionJournal&) = delete;
+    SessionJournal& operator=(const SessionJournal&) = delete;
+
+    ~SessionJournal() {
+        stop();
+    }
+
+    // Восстановить сессии из журнала (вызывается до start)
+    static std::vector<std::shared_ptr<GameSession>> recover(const std::string& path) {
+        std::vector<std::shared_ptr<GameSession>> result;
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return result; // Журнала еще нет - восстанавливать нечего
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return result;
+        }
+
+        size_t size = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            CROW_LOG_ERROR << "[Journal] mmap failed: " << std::strerror(errno);
+            return result;
+        }
+
+        const uint8_t* data = static_cast<const uint8_t*>(mapped);
+        std::unordered_map<std::string, std::shared_ptr<GameSession>> sessions;
+        size_t offset = 0;
+        size_t records = 0;
+
+        while (offset + 8 <= size) {
+            uint32_t length = readU32(data + offset);
+            uint32_t crc = readU32(data + offset + 4);
+            if (length == 0 || offset + 8 + length > size || crc32(data + offset + 8, length) != crc) {
+                break; // Оборванная запись в конце файла
+            }
+            Reader reader{data + offset + 8, data + offset + 8 + length};
+            if (!applyRecord(reader, sessions)) {
+                break;
+            }
+            offset += 8 + length;
+            ++records;
+        }
+
+        munmap(mapped, size);
+
+        if (offset < size) {
+            CROW_LOG_WARNING << "[Journal] Discarding " << (size - offset) << " bytes of torn tail";
+            if (truncate(path.c_str(), static_cast<off_t>(offset)) != 0) {
+                CROW_LOG_ERROR << "[Journal] truncate failed: " << std::strerror(errno);
+            }
+        }
+
+        for (auto& [code, session] : sessions) {
+            if (!session->isExpired()) {
+                result.push_back(session);
+            }
+        }
+
+        CROW_LOG_INFO << "[Journal] Replayed " << records << " records, restored "
+                  << result.size() << " sessions";
+        return result;
+    }
+
+    // Открыть журнал на дозапись и запустить поток записи
+    bool start(const std::string& path, unsigned flushMs, uint64_t compactBytes, SessionsProvider provider) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            CROW_LOG_ERROR << "[Journal] Failed to open " << path << ": " << std::strerror(errno);
+            return false;
+        }
+
+        struct stat st;
+        fileSize_ = (fstat(fd_, &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+        path_ = path;
+        flushInterval_ = std::chrono::milliseconds(flushMs);
+        compactBytes_ = compactBytes;
+        provider_ = std::move(provider);
+        stopping_ = false;
+        enabled_ = true;
+        writer_ = std::thread([this] {
+#ifdef __linux__
+            pthread_setname_np(pthread_self(), "sb-journal");
+#endif
+            writerLoop();
+        });
+        return true;
+    }
+
+    // Дописать оставшиеся записи и остановить поток записи
+    void stop() {
+        if (!writer_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        writer_.join();
+        enabled_ = false;
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    bool isEnabled() const {
+        return enabled_;
+    }
+
+    // Журнал отключен из-за ошибок записи на диск
+    bool isFailed() const {
+        return failed_;
+    }
+
+    uint64_t writeErrors() const {
+        return writeErrors_;
+    }
+
+    // Попросить поток записи сжать журнал в снимок
+    void requestCompaction() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            compactionRequested_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    // Методы record* вызываются под мьютексом сессии
+
+    void recordCreate(GameSession& session) {
+        if (!enabled_) return;
+        Buffer body = beginRecord(RecordType::CREATE, session);
+        body.str(session.player1.reconnectToken);
+        body.str(session.player1.playerId);
+        append(body);
+    }
+
+    void recordJoin(GameSession& session) {
+        if (!enabled_) return;
+        Buffer body = beginRecord(RecordType::JOIN, session);
+        body.str(session.player2.reconnectToken);
+        body.str(session.player2.playerId);
+        append(body);
+    }
+
+    void recordPlace(GameSession& session, int player) {
+        if (!enabled_) return;
+        Buffer body = beginRecord(RecordType::PLACE, session);
+        const Board& board = (player == 1) ? session.player1.board : session.player2.board;
+        body.u8(static_cast<uint8_t>(player));
+        body.u32(static_cast<uint32_t>(board.ships.size()));
+        for (const auto& ship : board.ships) {
+            body.cells(ship.cells);
+        }
+        append(body);
+    }
+
+    void recordShot(GameSession& session, int x, int y) {
+        if (!enabled_) return;
+        Buffer body = beginRecord(RecordType::SHOT, session);
+        body.i32(x);
+        body.i32(y);
+        append(body);
+    }
+
+    // Снимок одной сессии в формате записи журнала (для передачи состояния
+    // при горячем перезапуске). Вызывается под мьютексом сессии
+    static std::string encodeSession(const GameSession& session) {
+        std::string out;
+        encodeSnapshot(out, session);
+        return out;
+    }
+
+    static std::shared_ptr<GameSession> decodeSession(const std::string& record) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(record.data());
+        if (record.size() < 8 || 8 + static_cast<size_t>(readU32(data)) != record.size() ||
+            crc32(data + 8, record.size() - 8) != readU32(data + 4)) {
+            return nullptr;
+        }
+        Reader reader{data + 8, data + record.size()};
+        std::unordered_map<std::string, std::shared_ptr<GameSession>> sessions;
+        if (!applyRecord(reader, sessions) || sessions.empty()) {
+            return nullptr;
+        }
+        return sessions.begin()->second;
+    }
+
+private:
+    enum class RecordType : uint8_t {
+        CREATE = 1,
+        JOIN = 2,
+        PLACE = 3,
+        SHOT = 4,
+        SNAPSHOT = 5
+    };
+
+    // Буфер для кодирования записи (little-endian)
+    struct Buffer {
+        std::string data;
+
+        void u8(uint8_t v) { data.push_back(static_cast<char>(v)); }
+        void u32(uint32_t v) { for (int i = 0; i < 4; ++i) u8(static_cast<uint8_t>(v >> (8 * i))); }
+        void u64(uint64_t v) { for (int i = 0; i < 8; ++i) u8(static_cast<uint8_t>(v >> (8 * i))); }
+        void i32(int v) { u32(static_cast<uint32_t>(v)); }
+        void str(const std::string& s) {
+            u32(static_cast<uint32_t>(s.size()));
+            data.append(s);
+        }
+        template<typename Cells>
+        void cells(const Cells& c) {
+            u32(static_cast<uint32_t>(c.size()));
+            for (const auto& cell : c) {
+                i32(cell.first);
+                i32(cell.second);
+            }
+        }
+    };
+
+    // Чтение записи с проверкой границ
+    struct Reader {
+        const uint8_t* pos;
+        const uint8_t* end;
+        bool ok = true;
+
+        bool has(size_t n) {
+            if (static_cast<size_t>(end - pos) < n) ok = false;
+            return ok;
+        }
+        uint8_t u8() { return has(1) ? *pos++ : 0; }
+        uint32_t u32() {
+            if (!has(4)) return 0;
+            uint32_t v = readU32(pos);
+            pos += 4;
+            return v;
+        }
+        uint64_t u64() {
+            uint64_t lo = u32();
+            uint64_t hi = u32();
+            return lo | (hi << 32);
+        }
+        int i32() { return static_cast<int>(u32()); }
+        std::string str() {
+            uint32_t n = u32();
+            if (!has(n)) return {};
+            std::string s(reinterpret_cast<const char*>(pos), n);
+            pos += n;
+            return s;
+        }
+        std::vector<std::pair<int, int>> cells() {
+            std::vector<std::pair<int, int>> result;
+            uint32_t n = u32();
+            if (!has(static_cast<size_t>(n) * 8)) return result;
+            result.reserve(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                int x = i32();
+                int y = i32();
+                result.push_back({x, y});
+            }
+            return result;
+        }
+    };
+
+    static uint32_t readU32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    static uint32_t crc32(const uint8_t* data, size_t size) {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    static uint64_t wallClockMs(std::chrono::system_clock::time_point tp) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count());
+    }
+
+    // Перевод времени из журнала в момент последней активности сессии
+    static std::chrono::steady_clock::time_point activityFromWallClock(uint64_t ms) {
+        auto now = wallClockMs(std::chrono::system_clock::now());
+        auto age = (now > ms) ? std::chrono::milliseconds(now - ms) : std::chrono::milliseconds(0);
+        return std::chrono::steady_clock::now() - age;
+    }
+
+    static Buffer beginRecord(RecordType type, GameSession& session) {
+        Buffer body;
+        body.u8(static_cast<uint8_t>(type));
+        body.u64(wallClockMs(std::chrono::system_clock::now()));
+        body.u64(++session.journalSeq);
+        body.str(session.roomCode);
+        return body;
+    }
+
+    static void frame(std::string& out, const Buffer& body) {
+        Buffer header;
+        header.u32(static_cast<uint32_t>(body.data.size()));
+        header.u32(crc32(reinterpret_cast<const uint8_t*>(body.data.data()), body.data.size()));
+        out.append(header.data);
+        out.append(body.data);
+    }
+
+    void append(const Buffer& body) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame(pending_, body);
+        }
+        cv_.notify_one();
+    }
+
+    // Полное состояние сессии для снимка
+    static void encodePlayer(Buffer& body, const Player& player) {
+        body.str(player.playerId);
+        body.u8(player.shipsPlaced ? 1 : 0);
+        body.u32(static_cast<uint32_t>(player.stats.shots));
+        body.u32(static_cast<uint32_t>(player.stats.hits));
+        body.u32(static_cast<uint32_t>(player.stats.misses));
+        body.u32(static_cast<uint32_t>(player.stats.sunkShips));
+        body.u32(static_cast<uint32_t>(player.board.ships.size()));
+        for (const auto& ship : player.board.ships) {
+            body.cells(ship.cells);
+            body.cells(ship.heatedCells);
+            body.u8(ship.isKilled ? 1 : 0);
+        }
+        body.cells(player.board.shootedCells);
+    }
+
+    static void decodePlayer(Reader& reader, Player& player) {
+        player.socket = nullptr;
+        player.playerId = reader.str();
+        player.shipsPlaced = reader.u8() != 0;
+        player.stats.shots = static_cast<int>(reader.u32());
+        player.stats.hits = static_cast<int>(reader.u32());
+        player.stats.misses = static_cast<int>(reader.u32());
+        player.stats.sunkShips = static_cast<int>(reader.u32());
+        player.stats.updateAccuracy();
+
+        uint32_t shipCount = reader.u32();
+        player.board.ships.clear();
+        for (uint32_t i = 0; i < shipCount && reader.ok; ++i) {
+            Ship ship(reader.cells());
+            ship.heatedCells = reader.cells();
+            ship.isKilled = reader.u8() != 0;
+            player.board.ships.push_back(std::move(ship));
+        }
+        auto shooted = reader.cells();
+        player.board.shootedCells = std::set<std::pair<int, int>>(shooted.begin(), shooted.end());
+    }
+
+    static void encodeSnapshot(std::string& out, const GameSession& session) {
+        auto wallNow = std::chrono::system_clock::now();
+        auto idle = std::chrono::steady_clock::now() - session.lastActivity;
+
+        Buffer body;
+        body.u8(static_cast<uint8_t>(RecordType::SNAPSHOT));
+        body.u64(wallClockMs(wallNow - std::chrono::duration_cast<std::chrono::system_clock::duration>(idle)));
+        body.u64(session.journalSeq);
+        body.str(session.roomCode);
+        body.u8(static_cast<uint8_t>(session.state));
+        body.u8(static_cast<uint8_t>(session.currentTurn));
+        encodePlayer(body, session.player1);
+        encodePlayer(body, session.player2);
+        body.str(session.player1.reconnectToken);
+        body.str(session.player2.reconnectToken);
+        frame(out, body);
+    }
+
+    // Применить одну запись к восстанавливаемым сессиям
+    static bool applyRecord(Reader& reader,
+                            std::unordered_map<std::string, std::shared_ptr<GameSession>>& sessions) {
+        auto type = static_cast<RecordType>(reader.u8());
+        uint64_t timestamp = reader.u64();
+        uint64_t seq = reader.u64();
+        std::string roomCode = reader.str();
+        if (!reader.ok) return false;
+
+        if (type == RecordType::SNAPSHOT) {
+            Player empty;
+            auto session = std::make_shared<GameSession>(roomCode, empty);
+            session->state = static_cast<GameState>(reader.u8());
+            session->currentTurn = reader.u8();
+            decodePlayer(reader, session->player1);
+            decodePlayer(reader, session->player2);
+            if (reader.pos != reader.end) {
+                session->player1.reconnectToken = reader.str();
+                session->player2.reconnectToken = reader.str();
+            }
+            session->journalSeq = seq;
+            session->lastActivity = activityFromWallClock(timestamp);
+            if (reader.ok) sessions[roomCode] = session;
+            return reader.ok;
+        }
+
+        if (type == RecordType::CREATE) {
+            Player player1(nullptr, "player1");
+            if (reader.pos != reader.end) {
+                player1.reconnectToken = reader.str();
+            }
+            if (reader.pos != reader.end) {
+                player1.playerId = reader.str();
+            }
+            auto session = std::make_shared<GameSession>(roomCode, player1);
+            session->journalSeq = seq;
+            session->lastActivity = activityFromWallClock(timestamp);
+            sessions[roomCode] = session;
+            return true;
+        }
+
+        auto it = sessions.find(roomCode);
+        if (it == sessions.end() || seq <= it->second->journalSeq) {
+            return true; // Событие уже учтено в снимке или сессия удалена
+        }
+        GameSession& session = *it->second;
+
+        switch (type) {
+            case RecordType::JOIN:
+                session.player2 = Player(nullptr, "player2");
+                if (reader.pos != reader.end) {
+                    session.player2.reconnectToken = reader.str();
+                }
+                if (reader.pos != reader.end) {
+                    session.player2.playerId = reader.str();
+                }
+                session.state = GameState::PLACING_SHIPS;
+                break;
+
+            case RecordType::PLACE: {
+                int playerIndex = reader.u8();
+                uint32_t shipCount = reader.u32();
+                Player& player = (playerIndex == 1) ? session.player1 : session.player2;
+                player.board.ships.clear();
+                for (uint32_t i = 0; i < shipCount && reader.ok; ++i) {
+                    player.board.ships.push_back(Ship(reader.cells()));
+                }
+                player.shipsPlaced = true;
+                if (session.player1.shipsPlaced && session.player2.shipsPlaced) {
+                    session.state = GameState::IN_GAME;
+                }
+                break;
+            }
+
+            case RecordType::SHOT: {
+                int x = reader.i32();
+                int y = reader.i32();
+                if (reader.ok) GameEngine::processShot(session, x, y);
+                break;
+            }
+
+            default:
+                return false;
+        }
+
+        session.journalSeq = seq;
+        session.lastActivity = activityFromWallClock(timestamp);
+        return reader.ok;
+    }
+
+    bool writeAll(int fd, const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                CROW_LOG_ERROR << "[Journal] write failed: " << std::strerror(errno);
+                return false;
+            }
+            written += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Записать пачку и дождаться fdatasync. При ошибке файл обрезается до
+    // прежнего размера, чтобы повтор не оставил за собой оборванную запись
+    bool writeBatch(const std::string& batch) {
+        if (writeAll(fd_, batch)) {
+            if (fdatasync(fd_) == 0) {
+                fileSize_ += batch.size();
+                consecutiveFailures_ = 0;
+                return true;
+            }
+            CROW_LOG_ERROR << "[Journal] fdatasync failed: " << std::strerror(errno);
+        }
+        ++writeErrors_;
+        if (ftruncate(fd_, static_cast<off_t>(fileSize_)) != 0) {
+            CROW_LOG_ERROR << "[Journal] truncate failed: " << std::strerror(errno);
+        }
+        return false;
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || compactionRequested_ || !pending_.empty(); });
+
+            // Групповая запись: даем соседним событиям попасть в ту же пачку
+            if (!stopping_ && !compactionRequested_) {
+                cv_.wait_for(lock, flushInterval_, [this] {
+                    return stopping_ || pending_.size() >= kMaxBatchBytes;
+                });
+            }
+
+            std::string batch;
+            batch.swap(pending_);
+            bool compact = compactionRequested_;
+            compactionRequested_ = false;
+            if (failed_) {
+                batch.clear(); // События после отключения не пишутся: в журнале был бы пропуск
+                compact = false;
+            }
+            lock.unlock();
+
+            bool written = batch.empty() || writeBatch(batch);
+            if (written && (compact || fileSize_ >= compactBytes_ + snapshotSize_)) {
+                compactToSnapshot();
+            }
+
+            lock.lock();
+            if (!written) {
+                // Неудавшаяся пачка остается первой в очереди
+                pending_.insert(0, batch);
+                compactionRequested_ = compactionRequested_ || compact;
+                if (++consecutiveFailures_ >= kMaxWriteFailures) {
+                    CROW_LOG_ERROR << "[Journal] Disabled after " << consecutiveFailures_ << " failed writes, "
+                                   << pending_.size() << " bytes of events lost";
+                    failed_ = true;
+                    enabled_ = false;
+                    pending_.clear();
+                    compactionRequested_ = false;
+                } else {
+                    cv_.wait_for(lock, kRetryDelay, [this] { return stopping_; });
+                }
+            }
+            if (stopping_ && pending_.empty()) {
+                break;
+            }
+        }
+    }
+
+    // Переписать журнал снимком живых сессий
+    void compactToSnapshot() {
+        if (!provider_) return;
+
+        std::string snapshot;
+        size_t count = 0;
+        for (const auto& session : provider_()) {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            if (session->isExpired()) continue;
+            encodeSnapshot(snapshot, *session);
+            ++count;
+        }
+
+        std::string tmpPath = path_ + ".tmp";
+        int tmp = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (tmp < 0) {
+            CROW_LOG_ERROR << "[Journal] Failed to create snapshot: " << std::strerror(errno);
+            return;
+        }
+        if (!writeAll(tmp, snapshot) || fdatasync(tmp) != 0) {
+            ::close(tmp);
+            ::unlink(tmpPath.c_str());
+            return;
+        }
+        ::close(tmp);
+
+        std::string oldPath = path_ + ".old";
+        ::unlink(oldPath.c_str());
+        if (::link(path_.c_str(), oldPath.c_str()) != 0) {
+            CROW_LOG_ERROR << "[Journal] link failed: " << std::strerror(errno);
+            ::unlink(tmpPath.c_str());
+            return;
+        }
+        if (::rename(tmpPath.c_str(), path_.c_str()) != 0) {
+            CROW_LOG_ERROR << "[Journal] rename failed: " << std::strerror(errno);
+            ::unlink(tmpPath.c_str());
+            ::unlink(oldPath.c_str());
+            return;
+        }
+        if (!syncDirectory()) {
+            // Снимок мог не попасть на диск: продолжаем писать в старый журнал
+            if (::rename(oldPath.c_str(), path_.c_str()) != 0) {
+                CROW_LOG_ERROR << "[Journal] Failed to restore " << path_ << ": " << std::strerror(errno);
+            }
+            syncDirectory();
+            return;
+        }
+        ::unlink(oldPath.c_str());
+
+        int fd = ::open(path_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd < 0) {
+            CROW_LOG_ERROR << "[Journal] Failed to reopen " << path_ << ": " << std::strerror(errno);
+            return;
+        }
+        ::close(fd_);
+        fd_ = fd;
+        fileSize_ = snapshot.size();
+        snapshotSize_ = snapshot.size();
+
+        CROW_LOG_INFO << "[Journal] Compacted into snapshot of " << count << " sessions ("
+                  << fileSize_ << " bytes)";
+    }
+
+    // fsync каталога журнала, чтобы переименование пережило сбой питания
+    bool syncDirectory() {
+        auto slash = path_.rfind('/');
+        std::string dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path_.substr(0, slash));
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0 || ::fsync(fd) != 0) {
+            CROW_LOG_ERROR << "[Journal] fsync of " << dir << " failed: " << std::strerror(errno);
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+        ::close(fd);
+        return true;
+    }
+
+    static constexpr size_t kMaxBatchBytes = 256 * 1024;
+    static constexpr unsigned kMaxWriteFailures = 5;
+    static constexpr std::chrono::milliseconds kRetryDelay{200};
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t fileSize_ = 0;
+    uint64_t compactBytes_ = 0;
+    uint64_t snapshotSize_ = 0;
+    unsigned consecutiveFailures_ = 0;
+    std::chrono::milliseconds flushInterval_{10};
+    SessionsProvider provider_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::string pending_;
+    bool stopping_ = false;
+    bool compactionRequested_ = false;
+    std::atomic<bool> enabled_{false};
+    std::atomic<bool> failed_{false};
+    std::atomic<uint64_t> writeErrors_{0};
+    std::thread writer_;
+};
@@ -1,10 +1,15 @@
 #pragma once
 
 #include "types.h"
+#include "session_journal.h"
 #include <unordered_map>
+#include <array>
 #include <random>
 #include <sstream>
-#include <iomanip>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/random.h>
 
 class SessionManager {
 private:
@@ -12,13 +17,17 @@ private:
     std::mutex sessionsMutex;
     std::random_device rd;
     std::mt19937 gen;
+    SessionJournal* journal = nullptr;
+    unsigned shardIndex = 0;
+    unsigned shardCount = 1;
     
     // Генерация уникального кода комнаты
     std::string generateRoomCode() {
         std::uniform_int_distribution<> dis(0, 15);
         std::stringstream ss;
         for (int i = 0; i < 6; ++i) {
-            int val = dis(gen);
+            // Первый символ кода - номер шарда, которому принадлежит комната
+            int val = (i == 0 && shardCount > 1) ? static_cast<int>(shardIndex) : dis(gen);
             if (val < 10) {
                 ss << val;
             } else {
@@ -28,9 +37,60 @@ private:
         return ss.str();
     }
     
+    // Генерация токена переподключения (128 бит в hex).
+    // Токен дает место игрока, поэтому он берется из getrandom, а не из gen:
+    // по выходам mt19937 в собственных токенах клиент восстановил бы состояние
+    // генератора и предсказал чужие
+    static std::string generateToken() {
+        unsigned char bytes[16];
+        size_t filled = 0;
+        while (filled < sizeof(bytes)) {
+            ssize_t n = getrandom(bytes + filled, sizeof(bytes) - filled, 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("getrandom failed: ") + std::strerror(errno));
+            }
+            filled += static_cast<size_t>(n);
+        }
+        static const char digits[] = "0123456789abcdef";
+        std::string token;
+        for (unsigned char byte : bytes) {
+            token.push_back(digits[byte >> 4]);
+            token.push_back(digits[byte & 0xF]);
+        }
+        return token;
+    }
+    
 public:
     SessionManager() : gen(rd()) {}
     
+    // Номер этого процесса среди шардов
+    void configureShard(unsigned index, unsigned count) {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        shardIndex = index;
+        shardCount = count;
+    }
+    
+    // Номер шарда по коду комнаты (-1 для некорректного кода)
+    static int shardOfRoom(const std::string& roomCode) {
+        if (roomCode.empty()) return -1;
+        char c = roomCode[0];
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+    
+    // Принадлежит ли комната этому процессу
+    bool isLocalRoom(const std::string& roomCode) const {
+        return shardCount <= 1 || shardOfRoom(roomCode) == static_cast<int>(shardIndex);
+    }
+    
+    // Подключить журнал: создание и присоединение будут в него записываться
+    void attachJournal(SessionJournal* j) {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        journal = j;
+    }
+    
     // Создать новую сессию
     std::string createSession(Player& player1) {
         std::lock_guard<std::mutex> lock(sessionsMutex);
@@ -40,9 +100,15 @@ public:
             roomCode = generateRoomCode();
         } while (sessions.find(roomCode) != sessions.end());
         
+        player1.reconnectToken = generateToken();
         auto session = std::make_shared<GameSession>(roomCode, player1);
         sessions[roomCode] = session;
         
+        if (journal) {
+            std::lock_guard<std::mutex> sessionLock(session->mutex);
+            journal->recordCreate(*session);
+        }
+        
         return roomCode;
     }
     
@@ -62,10 +128,15 @@ public:
             return nullptr; // Комната уже заполнена
         }
         
+        player2.reconnectToken = generateToken();
         session->player2 = player2;
         session->state = GameState::PLACING_SHIPS;
         session->updateActivity();
         
+        if (journal) {
+            journal->recordJoin(*session);
+        }
+        
         return session;
     }
     
@@ -81,24 +152,74 @@ public:
         return it->second;
     }
     
+    // Вернуть восстановленную из журнала сессию
+    void restoreSession(const std::shared_ptr<GameSession>& session) {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        sessions[session->roomCode] = session;
+    }
+    
+    // Список всех сессий (копия, для снимка журнала)
+    std::vector<std::shared_ptr<GameSession>> listSessions() {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        
+        std::vector<std::shared_ptr<GameSession>> result;
+        result.reserve(sessions.size());
+        for (auto& [code, session] : sessions) {
+            result.push_back(session);
+        }
+        return result;
+    }
+    
     // Удалить сессию
     void removeSession(const std::string& roomCode) {
         std::lock_guard<std::mutex> lock(sessionsMutex);
         sessions.erase(roomCode);
     }
     
-    // Очистить истекшие сессии
-    void cleanupExpiredSessions() {
+    // Очистить истекшие сессии, возвращает число удаленных
+    size_t cleanupExpiredSessions() {
         std::lock_guard<std::mutex> lock(sessionsMutex);
         
+        size_t removed = 0;
         auto it = sessions.begin();
         while (it != sessions.end()) {
             if (it->second->isExpired()) {
                 it = sessions.erase(it);
+                ++removed;
             } else {
                 ++it;
             }
         }
+        return removed;
+    }
+    
+    // Число активных сессий
+    size_t sessionCount() {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        return sessions.size();
+    }
+    
+    // Число идущих игр (расстановка или бой). Сессии блокируются по одной
+    // уже после снятия sessionsMutex, как и в остальном коде
+    size_t liveSessionCount() {
+        size_t live = 0;
+        for (const auto& session : listSessions()) {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            if (session->state == GameState::PLACING_SHIPS || session->state == GameState::IN_GAME) {
+                ++live;
+            }
+        }
+        return live;
+    }
+    
+    // Число сессий в каждом состоянии, по порядку значений GameState
+    std::array<size_t, 4> sessionCountByState() {
+        std::array<size_t, 4> counts{};
+        for (const auto& session : listSessions()) {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            ++counts[static_cast<size_t>(session->state)];
+        }
+        return counts;
     }
     
     // Получить сессию по WebSocket соединению
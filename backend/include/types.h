@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <chrono>
@@ -98,11 +99,15 @@ struct Player {
     PlayerStats stats;
     bool shipsPlaced;
     std::string playerId;
+    std::string reconnectToken; // Токен для возврата в игру (RESUME)
+    uint64_t lastSeq;           // Номер последнего события, отправленного игроку
+    // События для повторной отправки: тот же буфер, что ушел в соединение
+    std::deque<std::pair<uint64_t, crow::websocket::shared_message_ptr>> outbox;
     
-    Player() : socket(nullptr), shipsPlaced(false) {}
+    Player() : socket(nullptr), shipsPlaced(false), lastSeq(0) {}
     
     Player(crow::websocket::connection* ws, const std::string& id) 
-        : socket(ws), shipsPlaced(false), playerId(id) {}
+        : socket(ws), shipsPlaced(false), playerId(id), lastSeq(0) {}
 };
 
 // Игровая сессия
@@ -115,15 +120,16 @@ struct GameSession {
     std::mutex mutex;
     std::chrono::steady_clock::time_point createdAt;
     std::chrono::steady_clock::time_point lastActivity;
+    uint64_t journalSeq; // Номер последнего события сессии в журнале
     
-    GameSession() : currentTurn(1), state(GameState::WAITING_FOR_PLAYER) {
+    GameSession() : currentTurn(1), state(GameState::WAITING_FOR_PLAYER), journalSeq(0) {
         createdAt = std::chrono::steady_clock::now();
         lastActivity = createdAt;
     }
     
     GameSession(const std::string& code, Player& p1) 
         : roomCode(code), player1(p1), currentTurn(1), 
-          state(GameState::WAITING_FOR_PLAYER) {
+          state(GameState::WAITING_FOR_PLAYER), journalSeq(0) {
         createdAt = std::chrono::steady_clock::now();
         lastActivity = createdAt;
     }
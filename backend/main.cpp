@@ -2,13 +2,34 @@
 #include "include/session_manager.h"
 #include "include/game_engine.h"
 #include "include/json_serializer.h"
+#include "include/event_stream.h"
+#include "include/session_journal.h"
+#include "include/server_config.h"
+#include "include/node_link.h"
+#include "include/hot_restart.h"
+#include "include/maintenance_scheduler.h"
+#include "include/message_limits.h"
+#include "include/metrics.h"
+#include "include/latency_histograms.h"
+#include "include/game_trace.h"
 #include <crow.h>
 #include <thread>
 #include <chrono>
-#include <iostream>
+#include <sstream>
 #include <unordered_map>
+#include <condition_variable>
+#include <atomic>
+#include <csignal>
 
 SessionManager sessionManager;
+SessionJournal sessionJournal;
+NodeLink nodeLink;
+HotRestart hotRestart;
+GameTrace gameTrace;
+
+// Режим остановки по SIGTERM: новые игры не начинаются, текущие доигрываются
+std::atomic<bool> draining{false};
+std::chrono::steady_clock::time_point drainDeadline;
 
 // Глобальные переменные для хранения состояния соединений
 std::unordered_map<crow::websocket::connection*, std::shared_ptr<GameSession>> connectionSessions;
@@ -16,43 +37,60 @@ std::unordered_map<crow::websocket::connection*, std::string> connectionPlayerId
 std::unordered_map<crow::websocket::connection*, bool> connectionIsPlayer1;
 std::mutex connectionMutex;
 
+// Открытие и закрытие соединения в трассе игр
+void traceConnection(crow::websocket::connection& conn, GameTrace::Event event, const GameSession* session,
+                     int player) {
+    if (!gameTrace.isEnabled()) {
+        return;
+    }
+    GameTrace::Record record{};
+    record.timeNs = GameTrace::nowNs();
+    record.connection = reinterpret_cast<uintptr_t>(&conn);
+    record.room = session ? GameTrace::encodeRoom(session->roomCode) : GameTrace::kNoRoom;
+    record.event = event;
+    record.messageType = GameTrace::kUnknownType;
+    record.player = static_cast<uint8_t>(player);
+    gameTrace.record(record);
+}
+
 // Обработчик открытия WebSocket соединения
 void handleWebSocketOpen(crow::websocket::connection& conn) {
-    std::cout << "WebSocket connection opened" << std::endl;
+    CROW_LOG_DEBUG << "WebSocket connection opened";
+    traceConnection(conn, GameTrace::Open, nullptr, 0);
 }
 
 // Обработчик закрытия WebSocket соединения
 void handleWebSocketClose(crow::websocket::connection& conn, const std::string& reason, uint16_t code) {
-    std::cout << "WebSocket connection closed: " << reason << " (code: " << code << ")" << std::endl;
+    CROW_LOG_DEBUG << "WebSocket connection closed: " << reason << " (code: " << code << ")";
+    if (nodeLink.detach(conn)) {
+        traceConnection(conn, GameTrace::Close, nullptr, 0);
+        return; // Сессия этого клиента живет на другом узле
+    }
     std::lock_guard<std::mutex> lock(connectionMutex);
     
     auto it = connectionSessions.find(&conn);
+    if (it == connectionSessions.end() || !it->second) {
+        traceConnection(conn, GameTrace::Close, nullptr, 0);
+    }
     if (it != connectionSessions.end()) {
         auto currentSession = it->second;
         
         // Проверяем, что сессия существует (может быть nullptr если JOIN_SESSION не удался)
         if (currentSession) {
             bool isPlayer1 = connectionIsPlayer1[&conn];
+            traceConnection(conn, GameTrace::Close, currentSession.get(), isPlayer1 ? 1 : 2);
             
             std::lock_guard<std::mutex> sessionLock(currentSession->mutex);
             
-            // ВАЖНО: Обнуляем socket в сессии, чтобы избежать use-after-free
-            if (isPlayer1) {
-                currentSession->player1.socket = nullptr;
-                // Уведомляем player2 о разрыве соединения
-                if (currentSession->player2.socket) {
-                    currentSession->player2.socket->send_text(
-                        JsonSerializer::error("Противник отключился")
-                    );
-                }
-            } else {
-                currentSession->player2.socket = nullptr;
-                // Уведомляем player1 о разрыве соединения
-                if (currentSession->player1.socket) {
-                    currentSession->player1.socket->send_text(
-                        JsonSerializer::error("Противник отключился")
-                    );
-                }
+            Player& player = isPlayer1 ? currentSession->player1 : currentSession->player2;
+            Player& opponent = isPlayer1 ? currentSession->player2 : currentSession->player1;
+            
+            // ВАЖНО: Обнуляем socket в сессии, чтобы избежать use-after-free.
+            // Место остается за игроком: он может вернуться через RESUME
+            if (player.socket == &conn) {
+                player.socket = nullptr;
+                // Уведомляем противника о разрыве соединения
+                EventStream::send(opponent, JsonSerializer::error("Противник отключился"));
             }
         }
         
@@ -62,26 +100,350 @@ void handleWebSocketClose(crow::websocket::connection& conn, const std::string&
     }
 }
 
+// Комната живет на другом узле: пересылаем туда соединение по NodeLink,
+// а если связи с тем узлом нет - просим клиента переподключиться (REDIRECT)
+// Исходный текст сообщения уже разобран на месте, поэтому пересылается заново
+// сериализованный JSON
+void routeToOwner(crow::websocket::connection& conn, const std::string& roomCode, const crow::json::rvalue& json) {
+    int shard = SessionManager::shardOfRoom(roomCode);
+    if (shard >= 0 && nodeLink.canForward(static_cast<unsigned>(shard))) {
+        CROW_LOG_DEBUG << "[WS] Forwarding connection to shard " << shard;
+        nodeLink.attach(conn, static_cast<unsigned>(shard));
+        nodeLink.forward(conn, crow::json::wvalue(json).dump(), false);
+        return;
+    }
+    CROW_LOG_DEBUG << "[WS] Room " << roomCode << " belongs to shard " << shard << ", redirecting";
+    conn.send_text(JsonSerializer::redirect(roomCode));
+}
+
+// Полная синхронизация игрока, когда нужных событий уже нет в outbox
+void sendFullState(GameSession& session, bool isPlayer1) {
+    Player& player = isPlayer1 ? session.player1 : session.player2;
+    Player& opponent = isPlayer1 ? session.player2 : session.player1;
+
+    switch (session.state) {
+        case GameState::WAITING_FOR_PLAYER:
+            EventStream::send(player, JsonSerializer::sessionCreated(session.roomCode, player.reconnectToken));
+            break;
+
+        case GameState::PLACING_SHIPS:
+            EventStream::send(player, JsonSerializer::gameStart(1, session.roomCode, player.reconnectToken));
+            if (player.shipsPlaced) {
+                EventStream::send(player, JsonSerializer::shipsPlaced());
+            }
+            break;
+
+        case GameState::IN_GAME:
+            EventStream::send(player, JsonSerializer::stateMyShot(opponent.board), EventStream::kStateMyShot);
+            EventStream::send(player, JsonSerializer::stateEnemyShot(player.board), EventStream::kStateEnemyShot);
+            if (&session.getCurrentPlayer() == &player) {
+                EventStream::send(player, JsonSerializer::yourTurn());
+            }
+            break;
+
+        case GameState::FINISHED: {
+            // Победитель - тот, у чьего противника не осталось кораблей
+            std::string winner = session.player2.board.allShipsKilled() ? "player1" : "player2";
+            EventStream::send(player, JsonSerializer::gameOver(winner, player.stats));
+            break;
+        }
+    }
+}
+
+// Возврат в игру по токену переподключения
+void handleResume(crow::websocket::connection& conn, const crow::json::rvalue& json,
+                  std::unique_lock<std::mutex>& connLock) {
+    if (!json.has("roomCode") || !json.has("token")) {
+        connLock.unlock();
+        conn.send_text(JsonSerializer::error("Отсутствует поле 'roomCode' или 'token'"));
+        return;
+    }
+
+    if (connectionSessions.count(&conn) > 0) {
+        connLock.unlock();
+        conn.send_text(JsonSerializer::error("Соединение уже участвует в игре"));
+        return;
+    }
+
+    std::string roomCode = json["roomCode"].s();
+    std::string token = json["token"].s();
+    uint64_t lastSeq = json.has("lastSeq") ? json["lastSeq"].u() : 0;
+
+    if (!sessionManager.isLocalRoom(roomCode)) {
+        connLock.unlock();
+        routeToOwner(conn, roomCode, json);
+        return;
+    }
+
+    auto session = sessionManager.getSession(roomCode);
+    if (!session) {
+        connLock.unlock();
+        conn.send_text(JsonSerializer::error("Сессия не найдена"));
+        return;
+    }
+
+    auto lock = MessageTiming::lock(session->mutex);
+
+    bool isPlayer1;
+    if (!token.empty() && token == session->player1.reconnectToken) {
+        isPlayer1 = true;
+    } else if (!token.empty() && token == session->player2.reconnectToken) {
+        isPlayer1 = false;
+    } else {
+        connLock.unlock();
+        conn.send_text(JsonSerializer::error("Неверный токен переподключения"));
+        return;
+    }
+
+    Player& player = isPlayer1 ? session->player1 : session->player2;
+    Player& opponent = isPlayer1 ? session->player2 : session->player1;
+
+    // Старое соединение могло еще не закрыться - место переходит к новому
+    if (player.socket && player.socket != &conn) {
+        crow::websocket::connection* oldSocket = player.socket;
+        connectionSessions.erase(oldSocket);
+        connectionPlayerIds.erase(oldSocket);
+        connectionIsPlayer1.erase(oldSocket);
+        oldSocket->close("Игра продолжена в другом соединении", crow::websocket::NormalClosure);
+    }
+
+    player.socket = &conn;
+    connectionSessions[&conn] = session;
+    connectionPlayerIds[&conn] = player.playerId;
+    connectionIsPlayer1[&conn] = isPlayer1;
+    connLock.unlock();
+    Metrics::add(Metrics::SessionsResumed);
+
+    CROW_LOG_INFO << "[WS] RESUME: " << player.playerId << " returned to room " << roomCode
+              << " (client seq " << lastSeq << ", server seq " << player.lastSeq << ")";
+
+    // RESUMED не нумеруется: он сообщает, после какого номера продолжается поток
+    if (EventStream::canReplay(player, lastSeq)) {
+        conn.send_text(JsonSerializer::resumed(roomCode, player.playerId, lastSeq, false));
+        EventStream::replay(player, lastSeq);
+    } else {
+        // Нумерация продолжается после всего, что клиент уже видел
+        player.lastSeq = std::max(player.lastSeq, lastSeq);
+        conn.send_text(JsonSerializer::resumed(roomCode, player.playerId, player.lastSeq, true));
+        sendFullState(*session, isPlayer1);
+    }
+
+    session->updateActivity();
+    if (opponent.socket) {
+        EventStream::send(opponent, JsonSerializer::opponentReconnected());
+    }
+}
+
+// ==================== Горячий перезапуск ====================
+
+// Старый процесс: отвязать переданное соединение от его места в игре
+HotRestart::Client detachForHandoff(crow::websocket::connection& conn, int fd, uint64_t deliveredSeq) {
+    HotRestart::Client client;
+    client.fd = fd;
+    client.deliveredSeq = deliveredSeq;
+
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    auto it = connectionSessions.find(&conn);
+    if (it != connectionSessions.end()) {
+        if (it->second) {
+            client.roomCode = it->second->roomCode;
+            client.isPlayer1 = connectionIsPlayer1[&conn];
+
+            std::lock_guard<std::mutex> sessionLock(it->second->mutex);
+            Player& player = client.isPlayer1 ? it->second->player1 : it->second->player2;
+            if (player.socket == &conn) {
+                player.socket = nullptr;
+            }
+        }
+        connectionSessions.erase(it);
+        connectionPlayerIds.erase(&conn);
+        connectionIsPlayer1.erase(&conn);
+    }
+    return client;
+}
+
+// Старый процесс: остановить прием, заморозить соединения и собрать состояние.
+// Вызывается в потоке HotRestart, пока сервер продолжает работать
+HotRestart::State prepareHandoff(crow::SimpleApp& app) {
+    struct Pending {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<HotRestart::Client> clients;
+        size_t remaining = 0;
+        bool expired = false;
+    };
+
+    HotRestart::State state;
+    state.listenerFd = ::dup(app.native_acceptor_handle());
+    app.stop_accepting();
+
+    auto pending = std::make_shared<Pending>();
+    auto websockets = app.websockets();
+    pending->remaining = websockets.size();
+
+    for (auto& websocket : websockets) {
+        crow::websocket::connection* conn = websocket.get();
+
+        // Пересылаемые соединения не переносятся: клиенты вернутся через RESUME
+        if (nodeLink.isForwarded(*conn)) {
+            conn->close("Сервер перезапускается", crow::websocket::EndpointGoingAway);
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            --pending->remaining;
+            continue;
+        }
+
+        // Все события до этого номера уже стоят в очереди соединения и будут
+        // записаны до передачи; более поздние новый процесс дошлет из outbox
+        uint64_t deliveredSeq = 0;
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            auto it = connectionSessions.find(conn);
+            if (it != connectionSessions.end() && it->second) {
+                std::lock_guard<std::mutex> sessionLock(it->second->mutex);
+                deliveredSeq = connectionIsPlayer1[conn] ? it->second->player1.lastSeq : it->second->player2.lastSeq;
+            }
+        }
+
+        websocket->handoff([pending, conn, deliveredSeq](int fd) {
+            HotRestart::Client client;
+            if (fd >= 0) {
+                client = detachForHandoff(*conn, fd, deliveredSeq);
+            }
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            if (pending->expired) {
+                if (fd >= 0) ::close(fd); // Опоздало: клиент переподключится через RESUME
+                return;
+            }
+            if (fd >= 0) {
+                pending->clients.push_back(client);
+            }
+            --pending->remaining;
+            pending->cv.notify_all();
+        });
+    }
+
+    {
+        // Соединение, которое застряло посреди сообщения, не держит перезапуск
+        std::unique_lock<std::mutex> lock(pending->mutex);
+        pending->cv.wait_for(lock, std::chrono::seconds(2), [&] { return pending->remaining == 0; });
+        pending->expired = true;
+        state.clients = pending->clients;
+    }
+
+    // Игроки с других узлов и журнал переходят к новому процессу
+    nodeLink.stop();
+    state.sessions = sessionManager.listSessions();
+    sessionJournal.stop();
+    return state;
+}
+
+// Новый процесс: принять соединения, переданные старым
+void adoptConnections(crow::SimpleApp& app, crow::WebSocketRule<crow::SimpleApp>& rule,
+                      const std::vector<HotRestart::Client>& clients) {
+    for (const auto& client : clients) {
+        rule.adopt(client.fd, *app.pick_io_context(), [&client](crow::websocket::connection& conn) {
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            auto session = client.roomCode.empty() ? nullptr : sessionManager.getSession(client.roomCode);
+            if (!session) {
+                return; // Соединение еще не было в игре
+            }
+
+            connectionSessions[&conn] = session;
+            connectionPlayerIds[&conn] = client.isPlayer1 ? "player1" : "player2";
+            connectionIsPlayer1[&conn] = client.isPlayer1;
+
+            std::lock_guard<std::mutex> sessionLock(session->mutex);
+            Player& player = client.isPlayer1 ? session->player1 : session->player2;
+            player.socket = &conn;
+            EventStream::replay(player, client.deliveredSeq);
+        });
+    }
+    CROW_LOG_INFO << "[HotRestart] Adopted " << clients.size() << " connections";
+}
+
+// ==================== Остановка ====================
+
+// Перейти в режим остановки и предупредить всех подключенных клиентов.
+// Вызывается из обработчика сигналов в потоке приема соединений
+void startDrain(crow::SimpleApp& app, unsigned timeout) {
+    drainDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+    draining = true;
+
+    auto websockets = app.websockets();
+    CROW_LOG_INFO << "[Drain] Stopping: " << sessionManager.liveSessionCount() << " live sessions, "
+              << websockets.size() << " connections, deadline " << timeout << "s";
+    auto notice = crow::websocket::shared_message::text(JsonSerializer::serverDraining(timeout));
+    for (auto& websocket : websockets) {
+        websocket->send(notice);
+    }
+}
+
+// Остановить сервер, когда игры закончились или вышло время
+void checkDrain(crow::SimpleApp& app) {
+    if (!draining) {
+        return;
+    }
+    size_t live = sessionManager.liveSessionCount();
+    if (live == 0) {
+        CROW_LOG_INFO << "[Drain] All games finished, stopping";
+        app.stop();
+    } else if (std::chrono::steady_clock::now() >= drainDeadline) {
+        CROW_LOG_INFO << "[Drain] Deadline reached with " << live << " live sessions, stopping";
+        app.stop();
+    }
+}
+
 // Обработчик сообщений WebSocket
-void handleWebSocketMessage(crow::websocket::connection& conn, const std::string& data, bool is_binary) {
-    std::cout << "[WS] Message received: " << data << std::endl;
+// data - буфер соединения, JSON разбирается прямо в нем без копирования
+void handleWebSocketMessage(crow::websocket::connection& conn, std::string& data, bool is_binary) {
+    // Сообщение больше предела своего типа отклоняется до разбора JSON
+    if (!MessageLimits::fits(data)) {
+        Metrics::add(Metrics::ErrorsOversized);
+        CROW_LOG_WARNING << "[WS] Message rejected: " << data.size() << " bytes";
+        conn.send_text(JsonSerializer::error("Слишком большое сообщение"));
+        return;
+    }
+    
+    CROW_LOG_DEBUG << "[WS] Message received: " << data;
+    
+    // Соединение обслуживается узлом-владельцем комнаты
+    if (nodeLink.forward(conn, data, is_binary)) {
+        return;
+    }
+    
+    // Замер этапов обработки; записывается при выходе из функции
+    MessageTiming timing;
+    GameTrace::MessageScope trace(gameTrace, &conn);
     
     if (is_binary) {
-        std::cout << "[WS] Binary message rejected" << std::endl;
+        CROW_LOG_DEBUG << "[WS] Binary message rejected";
+        Metrics::add(Metrics::ErrorsBinary);
         conn.send_text(JsonSerializer::error("Бинарные сообщения не поддерживаются"));
         return;
     }
     
     try {
-        auto json = crow::json::load(data);
+        auto json = crow::json::load_inplace(data);
         if (!json) {
-            std::cout << "[WS] Invalid JSON" << std::endl;
+            CROW_LOG_DEBUG << "[WS] Invalid JSON";
+            Metrics::add(Metrics::ErrorsInvalidJson);
             conn.send_text(JsonSerializer::error("Неверный формат JSON"));
             return;
         }
         
         std::string type = json["type"].s();
-        std::cout << "[WS] Message type: " << type << std::endl;
+        CROW_LOG_DEBUG << "[WS] Message type: " << type;
+        // Предел до разбора брал тип из текста; разобранный тип мог оказаться
+        // другим (повторяющийся ключ "type"), поэтому предел проверяется еще раз
+        if (data.size() > MessageLimits::maxSize(type)) {
+            Metrics::add(Metrics::ErrorsOversized);
+            CROW_LOG_WARNING << "[WS] Message rejected: " << data.size() << " bytes of " << type;
+            conn.send_text(JsonSerializer::error("Слишком большое сообщение"));
+            return;
+        }
+        Metrics::add(Metrics::messageCounter(type));
+        timing.parsed(type);
+        trace.messageType(Metrics::messageTypeIndex(type));
         
         // Обработка PING для heartbeat
         if (type == "PING") {
@@ -89,7 +451,13 @@ void handleWebSocketMessage(crow::websocket::connection& conn, const std::string
             return;
         }
         
-        std::unique_lock<std::mutex> connLock(connectionMutex);
+        // Во время остановки новые игры не начинаются
+        if (draining && (type == "CREATE_SESSION" || type == "JOIN_SESSION")) {
+            conn.send_text(JsonSerializer::error("Сервер останавливается, новые игры не принимаются"));
+            return;
+        }
+        
+        std::unique_lock<std::mutex> connLock = MessageTiming::lock(connectionMutex);
         
         // Ищем существующую сессию для этого соединения (НЕ создаём новую запись!)
         std::shared_ptr<GameSession> currentSession = nullptr;
@@ -112,70 +480,91 @@ void handleWebSocketMessage(crow::websocket::connection& conn, const std::string
             connectionPlayerIds[&conn] = "player1";
             connectionIsPlayer1[&conn] = true;
             connLock.unlock();
+            Metrics::add(Metrics::SessionsCreated);
+            trace.session(roomCode, 1);
             
-            conn.send_text(JsonSerializer::sessionCreated(roomCode));
+            auto lock = MessageTiming::lock(newSession->mutex);
+            EventStream::send(newSession->player1,
+                              JsonSerializer::sessionCreated(roomCode, newSession->player1.reconnectToken));
             return;
         }
         
         // Присоединение к сессии
         if (type == "JOIN_SESSION") {
             if (!json.has("roomCode")) {
-                std::cout << "[WS] JOIN_SESSION: missing roomCode" << std::endl;
+                CROW_LOG_DEBUG << "[WS] JOIN_SESSION: missing roomCode";
                 connLock.unlock();
                 conn.send_text(JsonSerializer::error("Отсутствует поле 'roomCode'"));
                 return;
             }
             
             std::string roomCode = json["roomCode"].s();
-            std::cout << "[WS] JOIN_SESSION: trying to join room " << roomCode << std::endl;
+            CROW_LOG_DEBUG << "[WS] JOIN_SESSION: trying to join room " << roomCode;
+            
+            // Комната живет в другом процессе
+            if (!sessionManager.isLocalRoom(roomCode)) {
+                connLock.unlock();
+                routeToOwner(conn, roomCode, json);
+                return;
+            }
             Player player2(&conn, "player2");
             auto joinedSession = sessionManager.joinSession(roomCode, player2);
             
             if (!joinedSession) {
                 // НЕ сохраняем в connectionSessions при ошибке - соединение остается "чистым"
-                std::cout << "[WS] JOIN_SESSION: room not found or full, sending error" << std::endl;
+                CROW_LOG_DEBUG << "[WS] JOIN_SESSION: room not found or full, sending error";
+                Metrics::add(Metrics::ErrorsJoinFailed);
                 connLock.unlock();
                 conn.send_text(JsonSerializer::error("Комната не найдена или уже заполнена"));
-                std::cout << "[WS] JOIN_SESSION: error sent, connection still open" << std::endl;
+                CROW_LOG_DEBUG << "[WS] JOIN_SESSION: error sent, connection still open";
                 return;
             }
-            std::cout << "[WS] JOIN_SESSION: successfully joined room " << roomCode << std::endl;
+            CROW_LOG_DEBUG << "[WS] JOIN_SESSION: successfully joined room " << roomCode;
             
             // Только при успешном присоединении сохраняем в maps
             connectionSessions[&conn] = joinedSession;
             connectionPlayerIds[&conn] = "player2";
             connectionIsPlayer1[&conn] = false;
             
-            // Получаем сокеты для отправки
-            crow::websocket::connection* player1Socket = nullptr;
-            crow::websocket::connection* player2Socket = nullptr;
-            {
-                std::lock_guard<std::mutex> lock(joinedSession->mutex);
-                player1Socket = joinedSession->player1.socket;
-                player2Socket = joinedSession->player2.socket;
-            }
-            
             // Освобождаем connectionMutex перед отправкой сообщений
             connLock.unlock();
+            Metrics::add(Metrics::SessionsJoined);
+            trace.session(roomCode, 2);
             
-            // Уведомляем обоих игроков о начале игры (без блокировки connectionMutex)
-            if (player1Socket) {
-                player1Socket->send_text(JsonSerializer::gameStart(1));
-            }
-            if (player2Socket) {
-                player2Socket->send_text(JsonSerializer::gameStart(1));
-            }
+            // Уведомляем обоих игроков о начале игры, каждому - его токен
+            auto lock = MessageTiming::lock(joinedSession->mutex);
+            EventStream::send(joinedSession->player1,
+                              JsonSerializer::gameStart(1, roomCode, joinedSession->player1.reconnectToken));
+            EventStream::send(joinedSession->player2,
+                              JsonSerializer::gameStart(1, roomCode, joinedSession->player2.reconnectToken));
+            return;
+        }
+        
+        // Возврат в игру после разрыва соединения
+        if (type == "RESUME") {
+            handleResume(conn, json, connLock);
             return;
         }
         
         // Если сессия не найдена, игнорируем сообщение
         if (!currentSession) {
             connLock.unlock();
+            Metrics::add(Metrics::ErrorsNoSession);
             conn.send_text(JsonSerializer::error("Сессия не найдена"));
             return;
         }
         
-        std::lock_guard<std::mutex> lock(currentSession->mutex);
+        auto lock = MessageTiming::lock(currentSession->mutex);
+        trace.session(currentSession->roomCode, isPlayer1 ? 1 : 2);
+        
+        // Подтверждение полученных событий
+        if (type == "ACK") {
+            if (json.has("seq")) {
+                Player& player = isPlayer1 ? currentSession->player1 : currentSession->player2;
+                EventStream::acknowledge(player, json["seq"].u());
+            }
+            return;
+        }
         
         // Расстановка кораблей
         if (type == "PLACE_SHIPS") {
@@ -238,32 +627,25 @@ void handleWebSocketMessage(crow::websocket::connection& conn, const std::string
                 }
                 
                 player.shipsPlaced = true;
-                conn.send_text(JsonSerializer::shipsPlaced());
+                sessionJournal.recordPlace(*currentSession, isPlayer1 ? 1 : 2);
+                EventStream::send(player, JsonSerializer::shipsPlaced());
                 
                 // Проверка, готовы ли оба игрока
                 if (currentSession->player1.shipsPlaced && 
                     currentSession->player2.shipsPlaced) {
                     currentSession->state = GameState::IN_GAME;
                     // Уведомляем обоих игроков
-                    currentSession->player1.socket->send_text(
-                        JsonSerializer::bothPlayersReady()
-                    );
-                    currentSession->player2.socket->send_text(
-                        JsonSerializer::bothPlayersReady()
-                    );
+                    EventStream::send(currentSession->player1, JsonSerializer::bothPlayersReady());
+                    EventStream::send(currentSession->player2, JsonSerializer::bothPlayersReady());
                     // Отправляем YOUR_TURN первому игроку
                     // currentTurn всегда равен 1 при начале игры
-                    std::cout << "Отправка YOUR_TURN, currentTurn: " << currentSession->currentTurn << std::endl;
+                    CROW_LOG_DEBUG << "Отправка YOUR_TURN, currentTurn: " << currentSession->currentTurn;
                     if (currentSession->currentTurn == 1) {
-                        std::cout << "Отправка YOUR_TURN player1" << std::endl;
-                        currentSession->player1.socket->send_text(
-                            JsonSerializer::yourTurn()
-                        );
+                        CROW_LOG_DEBUG << "Отправка YOUR_TURN player1";
+                        EventStream::send(currentSession->player1, JsonSerializer::yourTurn());
                     } else {
-                        std::cout << "Отправка YOUR_TURN player2" << std::endl;
-                        currentSession->player2.socket->send_text(
-                            JsonSerializer::yourTurn()
-                        );
+                        CROW_LOG_DEBUG << "Отправка YOUR_TURN player2";
+                        EventStream::send(currentSession->player2, JsonSerializer::yourTurn());
                     }
                 }
                 
@@ -297,16 +679,16 @@ void handleWebSocketMessage(crow::websocket::connection& conn, const std::string
                 
                 // Обработка выстрела (может переключить ход при промахе)
                 ShotResult result = GameEngine::processShot(*currentSession, x, y);
+                sessionJournal.recordShot(*currentSession, x, y);
+                trace.shot(x, y, static_cast<int>(result));
                 
                 // Отправка состояния стреляющему игроку (MY_SHOT) - состояние поля ЦЕЛИ
                 // Показывает стреляющему куда он попал по полю противника
-                conn.send_text(JsonSerializer::stateMyShot(target.board));
+                EventStream::send(shooter, JsonSerializer::stateMyShot(target.board), EventStream::kStateMyShot);
                 
                 // Отправка состояния цели (ENEMY_SHOT) - состояние её собственного поля
                 // Показывает цели куда по ней попали
-                if (target.socket) {
-                    target.socket->send_text(JsonSerializer::stateEnemyShot(target.board));
-                }
+                EventStream::send(target, JsonSerializer::stateEnemyShot(target.board), EventStream::kStateEnemyShot);
                 
                 // Проверка победы
                 if (result == ShotResult::WIN) {
@@ -314,21 +696,15 @@ void handleWebSocketMessage(crow::websocket::connection& conn, const std::string
                     std::string winner = isPlayer1 ? "player1" : "player2";
                     
                     // Отправляем каждому игроку его собственную статистику
-                    currentSession->player1.socket->send_text(
-                        JsonSerializer::gameOver(winner, currentSession->player1.stats)
-                    );
-                    if (currentSession->player2.socket) {
-                        currentSession->player2.socket->send_text(
-                            JsonSerializer::gameOver(winner, currentSession->player2.stats)
-                        );
-                    }
+                    EventStream::send(currentSession->player1,
+                                      JsonSerializer::gameOver(winner, currentSession->player1.stats));
+                    EventStream::send(currentSession->player2,
+                                      JsonSerializer::gameOver(winner, currentSession->player2.stats));
                 } else {
                     // Если игра не закончилась, отправляем YOUR_TURN следующему игроку
                     // После processShot ход уже переключен, если был промах
                     Player& nextPlayer = currentSession->getCurrentPlayer();
-                    if (nextPlayer.socket) {
-                        nextPlayer.socket->send_text(JsonSerializer::yourTurn());
-                    }
+                    EventStream::send(nextPlayer, JsonSerializer::yourTurn());
                 }
                 
                 currentSession->updateActivity();
@@ -336,43 +712,351 @@ void handleWebSocketMessage(crow::websocket::connection& conn, const std::string
             }
             
         // Неизвестный тип сообщения
+        Metrics::add(Metrics::ErrorsUnknownType);
         conn.send_text(JsonSerializer::error("Неизвестный тип сообщения: " + type));
         
     } catch (const std::exception& e) {
+        Metrics::add(Metrics::ErrorsException);
         conn.send_text(JsonSerializer::error("Ошибка обработки сообщения: " + std::string(e.what())));
     }
 }
 
-// Функция очистки истекших сессий
-void cleanupThread() {
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::minutes(5));
-        sessionManager.cleanupExpiredSessions();
+// ==================== Метрики ====================
+
+// Ответ /metrics в формате Prometheus. Счетчики транспорта берутся у потоков
+// ввода-вывода Crow, счетчики игры - из шардов Metrics; все складывается здесь,
+// во время опроса
+std::string renderMetrics(crow::SimpleApp& app) {
+    MetricsText out;
+    auto loads = app.io_context_loads();
+    
+    uint64_t connections = 0, received = 0, sent = 0;
+    for (auto* load : loads) {
+        connections += load->websockets();
+        received += load->bytes_received();
+        sent += load->bytes_sent();
+    }
+    out.family("seabattle_websocket_connections", "gauge", "Open WebSocket connections");
+    out.sample("seabattle_websocket_connections", connections);
+    out.family("seabattle_websocket_received_bytes_total", "counter", "WebSocket payload bytes received");
+    out.sample("seabattle_websocket_received_bytes_total", received);
+    out.family("seabattle_websocket_sent_bytes_total", "counter", "Bytes written to WebSocket connections");
+    out.sample("seabattle_websocket_sent_bytes_total", sent);
+    
+    // Очереди отправки по потокам: перекос показывает поток с медленными клиентами
+    out.family("seabattle_send_queue_bytes", "gauge", "Bytes waiting in WebSocket send queues, per io thread");
+    for (size_t i = 0; i < loads.size(); ++i) {
+        out.sample("seabattle_send_queue_bytes", loads[i]->queued_bytes(), "thread=\"" + std::to_string(i) + "\"");
+    }
+    auto& sendQueue = crow::websocket::global_send_queue_stats();
+    out.family("seabattle_send_queue_conflated_total", "counter", "Superseded STATE messages dropped from send queues");
+    out.sample("seabattle_send_queue_conflated_total", sendQueue.conflated);
+    out.family("seabattle_send_queue_evicted_total", "counter", "Connections closed for not reading their send queue");
+    out.sample("seabattle_send_queue_evicted_total", sendQueue.evicted);
+    
+    static const char* stateNames[] = {"waiting_for_player", "placing_ships", "in_game", "finished"};
+    auto byState = sessionManager.sessionCountByState();
+    out.family("seabattle_sessions", "gauge", "Game sessions by state");
+    for (size_t i = 0; i < byState.size(); ++i) {
+        out.sample("seabattle_sessions", byState[i], std::string("state=\"") + stateNames[i] + "\"");
+    }
+    
+    out.family("seabattle_messages_total", "counter", "Parsed WebSocket messages by type");
+    for (size_t i = 0; i < Metrics::kMessageTypeCount; ++i) {
+        auto counter = static_cast<Metrics::Counter>(Metrics::MessagesCreateSession + i);
+        out.sample("seabattle_messages_total", Metrics::total(counter),
+                   std::string("type=\"") + Metrics::messageTypeName(i) + "\"");
+    }
+    
+    out.family("seabattle_sessions_created_total", "counter", "Sessions created");
+    out.sample("seabattle_sessions_created_total", Metrics::total(Metrics::SessionsCreated));
+    out.family("seabattle_sessions_joined_total", "counter", "Second players joined");
+    out.sample("seabattle_sessions_joined_total", Metrics::total(Metrics::SessionsJoined));
+    out.family("seabattle_sessions_resumed_total", "counter", "Players returned to a session with RESUME");
+    out.sample("seabattle_sessions_resumed_total", Metrics::total(Metrics::SessionsResumed));
+    out.family("seabattle_sessions_expired_total", "counter", "Sessions removed after inactivity");
+    out.sample("seabattle_sessions_expired_total", Metrics::total(Metrics::SessionsExpired));
+    
+    out.family("seabattle_trace_dropped_total", "counter", "Game trace records dropped because a thread buffer was full");
+    out.sample("seabattle_trace_dropped_total", gameTrace.dropped());
+    out.family("seabattle_journal_write_errors_total", "counter", "Failed session journal writes, retried on the next flush");
+    out.sample("seabattle_journal_write_errors_total", sessionJournal.writeErrors());
+    out.family("seabattle_journal_failed", "gauge", "1 if the session journal was disabled after repeated write errors");
+    out.sample("seabattle_journal_failed", sessionJournal.isFailed() ? 1 : 0);
+    
+    // Ошибки игры и отказы транспорта (лимиты Crow, heartbeat) в одном семействе
+    auto& heartbeat = crow::websocket::global_heartbeat_stats();
+    auto& limits = crow::websocket::global_message_limit_stats();
+    const std::pair<const char*, uint64_t> errors[] = {
+        {"invalid_json", Metrics::total(Metrics::ErrorsInvalidJson)},
+        {"oversized", Metrics::total(Metrics::ErrorsOversized) + limits.oversized},
+        {"binary", Metrics::total(Metrics::ErrorsBinary)},
+        {"unknown_type", Metrics::total(Metrics::ErrorsUnknownType)},
+        {"no_session", Metrics::total(Metrics::ErrorsNoSession)},
+        {"join_failed", Metrics::total(Metrics::ErrorsJoinFailed)},
+        {"exception", Metrics::total(Metrics::ErrorsException)},
+        {"rate_limited", limits.dropped},
+        {"flooder_disconnected", limits.disconnected},
+        {"ping_timeout", heartbeat.timed_out}};
+    out.family("seabattle_errors_total", "counter", "Rejected messages and dropped connections by reason");
+    for (const auto& [kind, value] : errors) {
+        out.sample("seabattle_errors_total", value, std::string("kind=\"") + kind + "\"");
+    }
+    return out.str();
+}
+
+// Процентили времени обработки по типам сообщений и этапам, в микросекундах
+crow::json::wvalue latencyReport() {
+    crow::json::wvalue report = crow::json::wvalue::object();
+    for (size_t type = 0; type < Metrics::kMessageTypeCount; ++type) {
+        if (MessageLatency::merged(type, MessageLatency::Handler).count() == 0) {
+            continue;
+        }
+        for (size_t phase = 0; phase < MessageLatency::PhaseCount; ++phase) {
+            auto histogram = MessageLatency::merged(type, static_cast<MessageLatency::Phase>(phase));
+            auto& entry = report[Metrics::messageTypeName(type)][MessageLatency::phaseName(phase)];
+            entry["count"] = histogram.count();
+            entry["p50"] = histogram.percentile(0.5) / 1000.0;
+            entry["p99"] = histogram.percentile(0.99) / 1000.0;
+            entry["p999"] = histogram.percentile(0.999) / 1000.0;
+            entry["max"] = histogram.max() / 1000.0;
+        }
+    }
+    return report;
+}
+
+// Сводка за период: previous хранит гистограммы на момент прошлого вывода
+void logLatency(std::vector<LatencyHistogram>& previous) {
+    previous.resize(Metrics::kMessageTypeCount * MessageLatency::PhaseCount);
+    for (size_t type = 0; type < Metrics::kMessageTypeCount; ++type) {
+        std::ostringstream line;
+        uint64_t messages = 0;
+        for (size_t phase = 0; phase < MessageLatency::PhaseCount; ++phase) {
+            auto histogram = MessageLatency::merged(type, static_cast<MessageLatency::Phase>(phase));
+            auto& last = previous[type * MessageLatency::PhaseCount + phase];
+            auto period = histogram;
+            period -= last;
+            last = histogram;
+            // Каждое сообщение записывается в Handler ровно один раз
+            if (phase == MessageLatency::Handler) {
+                messages = period.count();
+            }
+            line << ", " << MessageLatency::phaseName(phase) << " " << period.percentile(0.5) / 1000.0
+                 << "/" << period.percentile(0.99) / 1000.0 << "/" << period.percentile(0.999) / 1000.0;
+        }
+        if (messages > 0) {
+            CROW_LOG_INFO << "[Latency] " << Metrics::messageTypeName(type) << ": " << messages << " messages"
+                      << line.str() << " us (p50/p99/p999)";
+        }
     }
 }
 
-int main() {
+// Уровень журнала из конфигурации (значение уже проверено при загрузке)
+crow::LogLevel parseLogLevel(const std::string& level) {
+    if (level == "debug") return crow::LogLevel::Debug;
+    if (level == "warning") return crow::LogLevel::Warning;
+    if (level == "error") return crow::LogLevel::Error;
+    return crow::LogLevel::Info;
+}
+
+int main(int argc, char** argv) {
+    // Ошибка в параметрах - сообщение с именем параметра и код 2, а не аварийное завершение
+    ServerConfig config;
+    try {
+        config = ServerConfig::load(argc, argv);
+    } catch (const std::exception& e) {
+        CROW_LOG_CRITICAL << "[Config] Invalid configuration: " << e.what();
+        return 2;
+    }
+    
+    // Журнал выводит отдельный поток, потоки игры только кладут записи в свой
+    // буфер. Обработчик объявлен раньше app и удаляется после него
+    std::unique_ptr<crow::AsyncLogHandler> asyncLog;
+    if (config.logBuffer > 0) {
+        auto format = config.logFormat == "json" ? crow::AsyncLogHandler::Format::Json
+                                                 : crow::AsyncLogHandler::Format::Text;
+        asyncLog = std::make_unique<crow::AsyncLogHandler>(config.logBuffer, format);
+        crow::logger::setHandler(asyncLog.get());
+    }
     crow::SimpleApp app;
+    app.loglevel(parseLogLevel(config.logLevel));
+    
+    sessionManager.configureShard(config.shardIndex, config.shardCount);
+    
+    // Горячий перезапуск: забираем работу у запущенного процесса
+    std::optional<HotRestart::State> handoff;
+    if (!config.handoffPath.empty()) {
+        handoff = HotRestart::takeOver(config.handoffPath);
+    }
+    if (handoff) {
+        for (const auto& session : handoff->sessions) {
+            sessionManager.restoreSession(session);
+        }
+        app.inherit_acceptor(handoff->listenerFd);
+    }
+    
+    // Восстановление сессий из журнала после перезапуска
+    if (!config.journalPath.empty()) {
+        if (!handoff) {
+            for (const auto& session : SessionJournal::recover(config.journalPath)) {
+                sessionManager.restoreSession(session);
+            }
+        }
+        if (sessionJournal.start(config.journalPath, config.journalFlushMs, config.journalCompactBytes,
+                                 [] { return sessionManager.listSessions(); })) {
+            // Сразу сжимаем журнал, чтобы следующий старт читал только снимок
+            sessionJournal.requestCompaction();
+            sessionManager.attachJournal(&sessionJournal);
+        }
+    }
+    
+    // Двоичная трасса игр для разбора в tools/trace_decode
+    if (!config.traceDir.empty()) {
+        if (gameTrace.start(config.traceDir, uint64_t(config.traceFileMb) * 1024 * 1024, config.traceFiles,
+                            config.traceFlushMs)) {
+            CROW_LOG_INFO << "[Trace] Writing game trace to " << config.traceDir;
+        }
+    }
+    
+    // Связь с узлами других шардов
+    if (config.linkPort != 0) {
+        nodeLink.start(config.linkBind, config.linkPort, config.linkSecret, config.shardIndex, config.peers,
+                       handleWebSocketMessage, handleWebSocketClose);
+    }
     
     // WebSocket endpoint
-    CROW_WEBSOCKET_ROUTE(app, "/ws")
+    auto& wsRule = CROW_WEBSOCKET_ROUTE(app, "/ws")
         .onopen(handleWebSocketOpen)
         .onclose(handleWebSocketClose)
         .onmessage(handleWebSocketMessage);
     
-    // Health check endpoint
+    // Health check endpoint: во время остановки отвечает 503, чтобы балансировщик
+    // снял узел, и сообщает число идущих игр, чтобы оркестратор дождался нуля
     CROW_ROUTE(app, "/health")
     ([]() {
-        return "OK";
+        crow::json::wvalue body;
+        body["status"] = draining ? "draining" : "ok";
+        body["liveSessions"] = sessionManager.liveSessionCount();
+        if (sessionJournal.isEnabled() || sessionJournal.isFailed()) {
+            body["journal"] = sessionJournal.isFailed() ? "failed" : "ok";
+        }
+        return crow::response(draining ? 503 : 200, body);
     });
     
-    // Запуск потока очистки
-    std::thread cleanup(cleanupThread);
-    cleanup.detach();
+    // Время обработки сообщений по типам (мкс): parse, lockWait, serialize, handler
+    CROW_ROUTE(app, "/latency")
+    ([]() {
+        return crow::response(200, latencyReport());
+    });
     
-    // Запуск сервера
-    app.port(18080).multithreaded().run();
+    // Метрики для Prometheus. Каждый шард опрашивается отдельно, напрямую
+    CROW_ROUTE(app, "/metrics")
+    ([&app]() {
+        crow::response response(renderMetrics(app));
+        response.set_header("Content-Type", "text/plain; version=0.0.4");
+        return response;
+    });
     
+    // SIGTERM запускает остановку с доигрыванием, повторный SIGTERM и SIGINT
+    // останавливают сервер сразу
+    app.signal_handler([&app, &config](int signal) {
+        if (signal == SIGTERM && !draining && config.drainTimeout > 0) {
+            startDrain(app, config.drainTimeout);
+        } else {
+            app.stop();
+        }
+    });
+    
+    // Периодическое обслуживание на таймере сервера
+    MaintenanceScheduler maintenance;
+    maintenance.every("cleanup", std::chrono::seconds(config.cleanupInterval), [] {
+        size_t removed = sessionManager.cleanupExpiredSessions();
+        Metrics::add(Metrics::SessionsExpired, removed);
+        if (removed > 0) {
+            CROW_LOG_INFO << "[Maintenance] Removed " << removed << " expired sessions";
+        }
+    });
+    maintenance.every("stats", std::chrono::seconds(config.statsInterval), [&app, pongs = uint64_t(0), latencyUs = uint64_t(0)]() mutable {
+        auto& sendQueue = crow::websocket::global_send_queue_stats();
+        auto& heartbeat = crow::websocket::global_heartbeat_stats();
+        auto& limits = crow::websocket::global_message_limit_stats();
+        // Средняя задержка pong за период между выводами статистики
+        uint64_t newPongs = heartbeat.pongs - pongs;
+        uint64_t newLatencyUs = heartbeat.latency_us - latencyUs;
+        pongs += newPongs;
+        latencyUs += newLatencyUs;
+        CROW_LOG_INFO << "[Stats] sessions: " << sessionManager.sessionCount()
+                  << ", connections: " << app.websockets().size()
+                  << ", conflated: " << sendQueue.conflated << ", evicted: " << sendQueue.evicted
+                  << ", ping: " << (newPongs ? newLatencyUs / newPongs / 1000.0 : 0.0) << " ms"
+                  << ", timed out: " << heartbeat.timed_out
+                  << ", dropped: " << limits.dropped << ", flooders: " << limits.disconnected
+                  << ", oversized: " << limits.oversized + Metrics::total(Metrics::ErrorsOversized);
+    });
+    maintenance.every("latency", std::chrono::seconds(config.statsInterval), [previous = std::vector<LatencyHistogram>()]() mutable {
+        logLatency(previous);
+    });
+    if (sessionJournal.isEnabled()) {
+        maintenance.every("journal-compaction", std::chrono::seconds(config.journalCompactInterval), [] {
+            sessionJournal.requestCompaction();
+        });
+    }
+    maintenance.every("drain", std::chrono::seconds(1), [&app] { checkDrain(app); });
+    app.tick(maintenance.resolution(), [&maintenance] { maintenance.tick(); });
+    
+    // Прием переданных соединений и ожидание следующего перезапуска
+    std::thread handoffThread;
+    if (!config.handoffPath.empty()) {
+        handoffThread = std::thread([&] {
+            if (app.wait_for_server_start() != std::cv_status::no_timeout) {
+                return;
+            }
+            if (handoff) {
+                adoptConnections(app, wsRule, handoff->clients);
+            }
+            hotRestart.listen(config.handoffPath, [&app] { return prepareHandoff(app); }, [&app] { app.stop(); });
+        });
+    }
+    
+    // Запуск сервера: потоки именуются sb-io-N (sb-io-main - прием соединений)
+    app.port(config.port).thread_name_prefix("sb-io").cpu_affinity(config.cpuAffinity)
+        .websocket_max_send_queue(config.wsSendQueueBytes, config.wsSendQueueMessages)
+        .websocket_heartbeat(std::chrono::seconds(config.wsPingInterval), config.wsPingMisses)
+        .websocket_max_payload(config.wsMaxPayload ? config.wsMaxPayload : UINT64_MAX)
+        .websocket_rate_limit(config.wsRateLimit, config.wsRateBurst, config.wsRateMaxDropped);
+    
+    // Параметры TCP для каждого принятого соединения
+    crow::socket_options socketOptions;
+    socketOptions.no_delay = config.tcpNoDelay;
+    socketOptions.quick_ack = config.tcpQuickAck;
+    socketOptions.busy_poll_us = config.tcpBusyPoll;
+    socketOptions.send_buffer = config.tcpSendBuffer;
+    socketOptions.receive_buffer = config.tcpReceiveBuffer;
+    socketOptions.user_timeout_ms = config.tcpUserTimeout;
+    socketOptions.keepalive_idle_s = config.tcpKeepaliveIdle;
+    socketOptions.keepalive_interval_s = config.tcpKeepaliveInterval;
+    socketOptions.keepalive_count = config.tcpKeepaliveCount;
+    app.socket_options(socketOptions);
+    app.reuse_port_acceptors(config.reusePort);
+    
+    // Unix socket вместо TCP: nginx на той же машине проксирует на unix:<путь>
+    if (!config.unixSocket.empty()) {
+        app.local_socket_path(config.unixSocket).local_socket_permissions(config.unixSocketMode);
+    }
+    if (config.threads > 0) {
+        app.concurrency(config.threads);
+    } else {
+        app.multithreaded();
+    }
+    app.run();
+    
+    if (handoffThread.joinable()) {
+        handoffThread.join();
+    }
+    hotRestart.stop();
+    nodeLink.stop();
+    sessionJournal.stop();
+    gameTrace.stop();
     return 0;
 }
 
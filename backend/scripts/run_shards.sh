@@ -0,0 +1,90 @@
+#!/bin/sh
+# Запуск backend несколькими независимыми процессами (шардами).
+#
+# Шард i слушает порт SEA_BATTLE_PORT + i и создает комнаты, код которых
+# начинается с i. Упавший шард перезапускается, не затрагивая остальные.
+# SIGTERM передается шардам, которые перед выходом доигрывают текущие партии
+# (--drain-timeout); скрипт ждет их завершения.
+#
+# Переменные окружения:
+#   SEA_BATTLE_SHARDS   - число шардов (по умолчанию 1)
+#   SEA_BATTLE_PORT     - порт шарда 0 (по умолчанию 18080)
+#   SEA_BATTLE_UNIX_SOCKET_DIR - каталог unix socket'ов; если задан, шард i
+#                          слушает <каталог>/ws-<i>.sock вместо порта (права
+#                          файла - SEA_BATTLE_UNIX_SOCKET_MODE)
+#   SEA_BATTLE_JOURNAL  - путь журнала; при нескольких шардах шард i пишет в <путь>.<i>
+#   SEA_BATTLE_LINK_PORT - порт связи шарда 0 (шард i - LINK_PORT + i); если
+#                          задан, шарды пересылают друг другу чужих игроков
+#   SEA_BATTLE_LINK_SECRET - общий секрет связи (по умолчанию случайный на запуск)
+#   SEA_BATTLE_HANDOFF_DIR - каталог для сокетов горячего перезапуска; если
+#                          задан, SIGHUP запускает новую версию $BIN, которая
+#                          забирает соединения и игры у работающих шардов
+#   SEA_BATTLE_BIN      - исполняемый файл backend
+
+SHARDS=${SEA_BATTLE_SHARDS:-1}
+BASE_PORT=${SEA_BATTLE_PORT:-18080}
+BIN=${SEA_BATTLE_BIN:-/app/build/SeaBattleBackend}
+
+# Адреса связи всех шардов: 127.0.0.1:LINK_PORT,127.0.0.1:LINK_PORT+1,...
+PEERS=
+if [ -n "$SEA_BATTLE_LINK_PORT" ]; then
+    i=0
+    while [ "$i" -lt "$SHARDS" ]; do
+        PEERS="${PEERS:+$PEERS,}127.0.0.1:$((SEA_BATTLE_LINK_PORT + i))"
+        i=$((i + 1))
+    done
+    if [ -z "$SEA_BATTLE_LINK_SECRET" ]; then
+        SEA_BATTLE_LINK_SECRET=$(od -An -N16 -tx1 /dev/urandom | tr -d ' \n')
+    fi
+    export SEA_BATTLE_LINK_SECRET
+fi
+
+run_shard() {
+    index=$1
+    child=
+    trap 'kill -TERM $child 2>/dev/null; wait $child; exit 0' TERM INT
+
+    set -- --port=$((BASE_PORT + index)) --shard-index="$index" --shard-count="$SHARDS"
+    if [ -n "$SEA_BATTLE_UNIX_SOCKET_DIR" ]; then
+        mkdir -p "$SEA_BATTLE_UNIX_SOCKET_DIR"
+        set -- "$@" --unix-socket="$SEA_BATTLE_UNIX_SOCKET_DIR/ws-$index.sock"
+    fi
+    if [ -n "$SEA_BATTLE_JOURNAL" ] && [ "$SHARDS" -gt 1 ]; then
+        set -- "$@" --journal="$SEA_BATTLE_JOURNAL.$index"
+    fi
+    if [ -n "$PEERS" ]; then
+        set -- "$@" --link-port=$((SEA_BATTLE_LINK_PORT + index)) --peers="$PEERS"
+    fi
+    if [ -n "$SEA_BATTLE_HANDOFF_DIR" ]; then
+        mkdir -p "$SEA_BATTLE_HANDOFF_DIR"
+        set -- "$@" --handoff="$SEA_BATTLE_HANDOFF_DIR/shard-$index.sock"
+        # Новый процесс забирает работу у старого, после чего старый завершается
+        args="$*"
+        trap 'echo "[Shards] hot restart of shard $index"; "$BIN" $args & child=$!' HUP
+    fi
+
+    while true; do
+        "$BIN" "$@" &
+        child=$!
+        # wait прерывается сигналом HUP, после него ждем уже новый процесс
+        while kill -0 "$child" 2>/dev/null; do
+            wait "$child"
+        done
+        echo "[Shards] shard $index exited, restarting"
+        sleep 1
+    done
+}
+
+pids=
+i=0
+while [ "$i" -lt "$SHARDS" ]; do
+    run_shard "$i" &
+    pids="$pids $!"
+    i=$((i + 1))
+done
+
+trap 'kill -TERM $pids 2>/dev/null; wait; exit 0' TERM INT
+trap 'kill -HUP $pids 2>/dev/null' HUP
+while true; do
+    wait
+done
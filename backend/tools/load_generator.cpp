@@ -0,0 +1,647 @@
+// Нагрузочный клиент игры: сколько одновременных игр держит один сервер.
+//
+// Открывает по два WebSocket соединения на игру к уже запущенному серверу,
+// сводит их в комнату (CREATE_SESSION/JOIN_SESSION), расставляет случайные
+// флоты и играет партии до GAME_OVER: каждый игрок стреляет по клеткам поля
+// в случайном порядке и перед каждым действием выжидает время на раздумье.
+// После конца партии те же соединения начинают следующую. Клиенты работают
+// на том же asio, что и сервер, по io_context на поток; обе стороны игры
+// обслуживает один поток, поэтому состояние игры не требует блокировок.
+//
+// Выводит игры и выстрелы в секунду, задержку выстрела (от отправки SHOT до
+// STATE с его результатом) и ошибки соединений. Сервер ограничивает частоту
+// сообщений соединения (--ws-rate-limit): для игры без раздумий его нужно
+// запускать с --ws-rate-limit=0.
+//
+// Сборка: cmake -DSEA_BATTLE_BUILD_TOOLS=ON
+// Запуск: load_generator [--host=127.0.0.1] [--port=18080] [--path=/ws] [--games=1000]
+//                        [--duration=30] [--threads=2] [--think-ms=100-500] [--ramp=5]
+
+#include <crow.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Ship = std::vector<std::pair<int, int>>;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 18080;
+    std::string path = "/ws";
+    unsigned games = 1000;
+    unsigned duration = 30;
+    unsigned threads = 2;
+    unsigned thinkMinMs = 100;
+    unsigned thinkMaxMs = 500;
+    unsigned ramp = 5;
+};
+
+const char* option(int argc, char** argv, const char* name) {
+    size_t length = std::strlen(name);
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--", 2) == 0 && std::strncmp(argv[i] + 2, name, length) == 0 &&
+            argv[i][2 + length] == '=') {
+            return argv[i] + 3 + length;
+        }
+    }
+    return nullptr;
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    if (auto v = option(argc, argv, "host")) options.host = v;
+    if (auto v = option(argc, argv, "port")) options.port = static_cast<uint16_t>(std::atoi(v));
+    if (auto v = option(argc, argv, "path")) options.path = v;
+    if (auto v = option(argc, argv, "games")) options.games = static_cast<unsigned>(std::atoi(v));
+    if (auto v = option(argc, argv, "duration")) options.duration = static_cast<unsigned>(std::atoi(v));
+    if (auto v = option(argc, argv, "threads")) options.threads = std::max(1, std::atoi(v));
+    if (auto v = option(argc, argv, "ramp")) options.ramp = static_cast<unsigned>(std::atoi(v));
+    // Одно число или диапазон "мин-макс"
+    if (auto v = option(argc, argv, "think-ms")) {
+        options.thinkMinMs = static_cast<unsigned>(std::atoi(v));
+        const char* dash = std::strchr(v, '-');
+        options.thinkMaxMs = dash ? static_cast<unsigned>(std::atoi(dash + 1)) : options.thinkMinMs;
+        options.thinkMaxMs = std::max(options.thinkMaxMs, options.thinkMinMs);
+    }
+    return options;
+}
+
+// Значение строкового поля из ответа сервера. Сервер пишет JSON без пробелов,
+// поэтому разбирать сообщения (STATE - около 1.5 КБ) целиком не нужно
+std::string_view stringField(std::string_view json, std::string_view name) {
+    std::string key = "\"" + std::string(name) + "\":\"";
+    size_t start = json.find(key);
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    start += key.size();
+    size_t end = json.find('"', start);
+    return end == std::string_view::npos ? std::string_view{} : json.substr(start, end - start);
+}
+
+// Кадр клиента. Маска нулевая, чтобы не тратить время клиента: сервер все
+// равно снимает ее для каждого кадра
+std::string clientFrame(uint8_t opcode, std::string_view payload) {
+    std::string frame;
+    frame.push_back(static_cast<char>(0x80 | opcode));
+    if (payload.size() < 126) {
+        frame.push_back(static_cast<char>(0x80 | payload.size()));
+    } else {
+        frame.push_back(static_cast<char>(0x80 | 126));
+        frame.push_back(static_cast<char>(payload.size() >> 8));
+        frame.push_back(static_cast<char>(payload.size() & 0xFF));
+    }
+    frame.append(4, '\0');
+    frame.append(payload);
+    return frame;
+}
+
+// Случайная расстановка по правилам GameEngine::validateShipPlacement:
+// 1x4, 2x3, 3x2, 4x1, корабли не касаются друг друга даже углами
+std::vector<Ship> randomFleet(std::mt19937& rng) {
+    for (;;) {
+        bool blocked[10][10] = {};
+        std::vector<Ship> fleet;
+        for (int size : {4, 3, 3, 2, 2, 2, 1, 1, 1, 1}) {
+            for (int attempt = 0; attempt < 100; ++attempt) {
+                bool vertical = rng() & 1;
+                int x = static_cast<int>(rng() % (vertical ? 10 : 11 - size));
+                int y = static_cast<int>(rng() % (vertical ? 11 - size : 10));
+                Ship ship;
+                for (int i = 0; i < size; ++i) {
+                    ship.emplace_back(vertical ? x : x + i, vertical ? y + i : y);
+                }
+                bool free = std::none_of(ship.begin(), ship.end(), [&](const auto& cell) {
+                    return blocked[cell.first][cell.second];
+                });
+                if (!free) {
+                    continue;
+                }
+                for (const auto& [cx, cy] : ship) {
+                    for (int nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, 9); ++nx) {
+                        for (int ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, 9); ++ny) {
+                            blocked[nx][ny] = true;
+                        }
+                    }
+                }
+                fleet.push_back(std::move(ship));
+                break;
+            }
+        }
+        if (fleet.size() == 10) {
+            return fleet;
+        }
+    }
+}
+
+std::string placeShipsMessage(const std::vector<Ship>& fleet) {
+    std::string message = R"({"type":"PLACE_SHIPS","ships":[)";
+    for (size_t i = 0; i < fleet.size(); ++i) {
+        message += i ? ",[" : "[";
+        for (size_t j = 0; j < fleet[i].size(); ++j) {
+            message += (j ? ",[" : "[") + std::to_string(fleet[i][j].first) + "," +
+                       std::to_string(fleet[i][j].second) + "]";
+        }
+        message += "]";
+    }
+    return message + "]}";
+}
+
+// Счетчики потока. Пишет только поток клиентов, главный поток читает их для
+// промежуточных строк
+struct alignas(64) Stats {
+    std::atomic<uint64_t> connected{0};
+    std::atomic<uint64_t> connectErrors{0};
+    std::atomic<uint64_t> disconnects{0};
+    std::atomic<uint64_t> serverErrors{0};
+    std::atomic<uint64_t> gamesFinished{0};
+    std::atomic<uint64_t> gamesAbandoned{0};
+    std::atomic<uint64_t> shots{0};
+    std::vector<uint32_t> shotRttUs; // Читается после остановки потока
+
+    static void add(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+struct Worker {
+    crow::asio::io_context io;
+    Stats stats;
+    std::mt19937 rng{std::random_device{}()};
+};
+
+class Game;
+
+// Одно соединение игрока
+class Player {
+public:
+    Player(Game& game, Worker& worker) : game_(game), worker_(worker), socket_(worker.io), thinkTimer_(worker.io) {}
+
+    void connect(const crow::tcp::endpoint& endpoint, const std::string& host, const std::string& path);
+    void send(std::string_view payload) { write(clientFrame(0x1, payload)); }
+    void close();
+
+    // После раздумья со случайной длительностью
+    template <typename Handler>
+    void think(unsigned minMs, unsigned maxMs, Handler handler) {
+        if (maxMs == 0) {
+            handler();
+            return;
+        }
+        auto delay = std::uniform_int_distribution<unsigned>(minMs, maxMs)(worker_.rng);
+        thinkTimer_.expires_after(std::chrono::milliseconds(delay));
+        thinkTimer_.async_wait([this, generation = generation_, handler](const crow::error_code& ec) {
+            if (!ec && generation == generation_) {
+                handler();
+            }
+        });
+    }
+
+    // Новая партия: раздумье над прошлой больше не нужно
+    void resetRound() {
+        thinkTimer_.cancel();
+        targets.clear();
+        for (int x = 0; x < 10; ++x) {
+            for (int y = 0; y < 10; ++y) {
+                targets.emplace_back(x, y);
+            }
+        }
+        std::shuffle(targets.begin(), targets.end(), worker_.rng);
+        nextTarget = 0;
+        shotPending = false;
+    }
+
+    // Состояние игрока в текущей партии
+    std::vector<std::pair<int, int>> targets;
+    size_t nextTarget = 0;
+    bool shotPending = false;
+    Clock::time_point shotSentAt;
+
+private:
+    void write(std::string frame);
+    void flush();
+    void read();
+    void parseFrames();
+
+    Game& game_;
+    Worker& worker_;
+    crow::tcp::socket socket_;
+    crow::asio::steady_timer thinkTimer_;
+    // Обработчики закрытого соединения приходят с устаревшим поколением
+    uint64_t generation_ = 0;
+    crow::asio::streambuf handshake_;
+    std::string request_;
+    std::array<char, 16384> chunk_;
+    std::string input_;
+    std::string message_; // Собирается из фрагментов
+    std::deque<std::string> output_;
+    bool writing_ = false;
+};
+
+// Пара игроков, которая играет партии одну за другой
+class Game {
+public:
+    Game(Worker& worker, const Options& options, crow::tcp::endpoint endpoint) :
+      worker_(worker), options_(options), endpoint_(std::move(endpoint)), players_{{{*this, worker}, {*this, worker}}},
+      timer_(worker.io) {}
+
+    void start(Clock::duration delay) {
+        timer_.expires_after(delay);
+        timer_.async_wait([this](const crow::error_code& ec) {
+            if (!ec) {
+                connect();
+            }
+        });
+    }
+
+    void stop() {
+        stopped_ = true;
+        timer_.cancel();
+        for (auto& player : players_) {
+            player.close();
+        }
+    }
+
+    void onConnected(bool ok) {
+        if (stopped_) {
+            return;
+        }
+        if (!ok) {
+            Stats::add(worker_.stats.connectErrors);
+            reconnect();
+            return;
+        }
+        Stats::add(worker_.stats.connected);
+        if (++connected_ == 2) {
+            newRound();
+        }
+    }
+
+    void onClosed() {
+        if (stopped_ || connected_ < 2) {
+            return;
+        }
+        Stats::add(worker_.stats.disconnects);
+        if (inRound_) {
+            Stats::add(worker_.stats.gamesAbandoned);
+        }
+        reconnect();
+    }
+
+    void onMessage(Player& player, std::string_view message) {
+        std::string_view type = stringField(message, "type");
+        Player& opponent = &player == &players_[0] ? players_[1] : players_[0];
+        if (type == "SESSION_CREATED") {
+            std::string join = R"({"type":"JOIN_SESSION","roomCode":")" + std::string(stringField(message, "roomCode")) +
+                               "\"}";
+            opponent.send(join);
+        } else if (type == "GAME_START") {
+            player.think(options_.thinkMinMs, options_.thinkMaxMs, [this, &player] {
+                player.send(placeShipsMessage(randomFleet(worker_.rng)));
+            });
+        } else if (type == "YOUR_TURN") {
+            player.think(options_.thinkMinMs, options_.thinkMaxMs, [this, &player] { shoot(player); });
+        } else if (type == "STATE") {
+            if (player.shotPending && stringField(message, "mode") == "MY_SHOT") {
+                player.shotPending = false;
+                auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - player.shotSentAt);
+                worker_.stats.shotRttUs.push_back(static_cast<uint32_t>(rtt.count()));
+            }
+        } else if (type == "GAME_OVER") {
+            // Приходит обоим игрокам; партия закончена, когда его получили оба
+            if (++gameOvers_ == 2) {
+                inRound_ = false;
+                Stats::add(worker_.stats.gamesFinished);
+                newRound();
+            }
+        } else if (type == "ERROR" || type == "REDIRECT") {
+            // Партия больше не продолжится предсказуемо: начинаем новую
+            Stats::add(worker_.stats.serverErrors);
+            if (inRound_) {
+                Stats::add(worker_.stats.gamesAbandoned);
+            }
+            newRound();
+        }
+    }
+
+private:
+    void connect() {
+        connected_ = 0;
+        inRound_ = false;
+        for (auto& player : players_) {
+            player.connect(endpoint_, options_.host, options_.path);
+        }
+    }
+
+    // Пауза перед новым подключением, чтобы отказ сервера не превратился в цикл
+    void reconnect() {
+        connected_ = 0;
+        inRound_ = false;
+        for (auto& player : players_) {
+            player.close();
+        }
+        start(std::chrono::seconds(1));
+    }
+
+    void newRound() {
+        if (stopped_) {
+            return;
+        }
+        inRound_ = true;
+        gameOvers_ = 0;
+        for (auto& player : players_) {
+            player.resetRound();
+        }
+        players_[0].send(R"({"type":"CREATE_SESSION"})");
+    }
+
+    void shoot(Player& player) {
+        if (player.nextTarget == player.targets.size()) {
+            return;
+        }
+        auto [x, y] = player.targets[player.nextTarget++];
+        player.shotPending = true;
+        player.shotSentAt = Clock::now();
+        Stats::add(worker_.stats.shots);
+        player.send(R"({"type":"SHOT","x":)" + std::to_string(x) + R"(,"y":)" + std::to_string(y) + "}");
+    }
+
+    Worker& worker_;
+    const Options& options_;
+    crow::tcp::endpoint endpoint_;
+    std::array<Player, 2> players_;
+    crow::asio::steady_timer timer_;
+    int connected_ = 0;
+    int gameOvers_ = 0;
+    bool inRound_ = false;
+    bool stopped_ = false;
+};
+
+void Player::connect(const crow::tcp::endpoint& endpoint, const std::string& host, const std::string& path) {
+    uint64_t generation = ++generation_;
+    input_.clear();
+    message_.clear();
+    output_.clear();
+    writing_ = false;
+    handshake_.consume(handshake_.size());
+    request_ = "GET " + path + " HTTP/1.1\r\nHost: " + host +
+               "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+               "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+
+    socket_.async_connect(endpoint, [this, generation](const crow::error_code& ec) {
+        if (generation != generation_) {
+            return;
+        }
+        if (ec) {
+            game_.onConnected(false);
+            return;
+        }
+        socket_.set_option(crow::tcp::no_delay(true));
+        crow::asio::async_write(socket_, crow::asio::buffer(request_), [this, generation](const crow::error_code& ec, size_t) {
+            if (generation != generation_) {
+                return;
+            }
+            if (ec) {
+                game_.onConnected(false);
+                return;
+            }
+            crow::asio::async_read_until(socket_, handshake_, "\r\n\r\n",
+              [this, generation](const crow::error_code& ec, size_t size) {
+                  if (generation != generation_) {
+                      return;
+                  }
+                  std::string response(crow::asio::buffers_begin(handshake_.data()),
+                                       crow::asio::buffers_begin(handshake_.data()) + (ec ? 0 : size));
+                  if (ec || response.compare(0, 12, "HTTP/1.1 101") != 0) {
+                      game_.onConnected(false);
+                      return;
+                  }
+                  // За ответом на handshake могут сразу идти кадры
+                  handshake_.consume(size);
+                  input_.assign(crow::asio::buffers_begin(handshake_.data()), crow::asio::buffers_end(handshake_.data()));
+                  handshake_.consume(handshake_.size());
+                  game_.onConnected(true);
+                  parseFrames();
+                  read();
+              });
+        });
+    });
+}
+
+void Player::close() {
+    ++generation_;
+    thinkTimer_.cancel();
+    crow::error_code ec;
+    socket_.close(ec);
+}
+
+void Player::write(std::string frame) {
+    output_.push_back(std::move(frame));
+    if (!writing_) {
+        flush();
+    }
+}
+
+void Player::flush() {
+    writing_ = true;
+    crow::asio::async_write(socket_, crow::asio::buffer(output_.front()),
+      [this, generation = generation_](const crow::error_code& ec, size_t) {
+          if (generation != generation_) {
+              return;
+          }
+          if (ec) {
+              game_.onClosed();
+              return;
+          }
+          output_.pop_front();
+          writing_ = false;
+          if (!output_.empty()) {
+              flush();
+          }
+      });
+}
+
+void Player::read() {
+    socket_.async_read_some(crow::asio::buffer(chunk_),
+      [this, generation = generation_](const crow::error_code& ec, size_t size) {
+          if (generation != generation_) {
+              return;
+          }
+          if (ec) {
+              game_.onClosed();
+              return;
+          }
+          input_.append(chunk_.data(), size);
+          parseFrames();
+          if (generation == generation_) {
+              read();
+          }
+      });
+}
+
+// Кадры сервера без маски
+void Player::parseFrames() {
+    uint64_t generation = generation_;
+    size_t offset = 0;
+    while (input_.size() - offset >= 2 && generation == generation_) {
+        const auto* header = reinterpret_cast<const unsigned char*>(input_.data() + offset);
+        bool fin = header[0] & 0x80;
+        uint8_t opcode = header[0] & 0x0F;
+        uint64_t length = header[1] & 0x7F;
+        size_t headerSize = 2;
+        if (length == 126) {
+            if (input_.size() - offset < 4) break;
+            length = (uint64_t(header[2]) << 8) | header[3];
+            headerSize = 4;
+        } else if (length == 127) {
+            if (input_.size() - offset < 10) break;
+            length = 0;
+            for (int i = 0; i < 8; ++i) {
+                length = (length << 8) | header[2 + i];
+            }
+            headerSize = 10;
+        }
+        if (input_.size() - offset - headerSize < length) {
+            break;
+        }
+        std::string_view payload(input_.data() + offset + headerSize, length);
+        offset += headerSize + length;
+
+        if (opcode == 0x9) {
+            write(clientFrame(0xA, payload)); // Heartbeat сервера
+        } else if (opcode == 0x8) {
+            game_.onClosed();
+            return;
+        } else if (opcode == 0x1 || opcode == 0x0) {
+            if (fin && message_.empty()) {
+                game_.onMessage(*this, payload);
+            } else {
+                message_.append(payload);
+                if (fin) {
+                    std::string message = std::move(message_);
+                    message_.clear();
+                    game_.onMessage(*this, message);
+                }
+            }
+        }
+    }
+    // Соединение могло быть переоткрыто из обработчика: его буфер уже новый
+    if (generation == generation_) {
+        input_.erase(0, offset);
+    }
+}
+
+void raiseFileLimit() {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+template <typename Field>
+uint64_t sum(const std::vector<std::unique_ptr<Worker>>& workers, Field field) {
+    uint64_t total = 0;
+    for (const auto& worker : workers) {
+        total += (worker->stats.*field).load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options = parseOptions(argc, argv);
+    raiseFileLimit();
+
+    crow::error_code ec;
+    auto address = crow::asio::ip::make_address(options.host, ec);
+    if (ec) {
+        std::fprintf(stderr, "invalid host address: %s\n", options.host.c_str());
+        return 2;
+    }
+    crow::tcp::endpoint endpoint(address, options.port);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::unique_ptr<Game>> games;
+    for (unsigned i = 0; i < options.threads; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // Игры подключаются равномерно в течение ramp секунд, чтобы не переполнить
+    // очередь приема соединений сервера
+    for (unsigned i = 0; i < options.games; ++i) {
+        auto& worker = *workers[i % workers.size()];
+        games.push_back(std::make_unique<Game>(worker, options, endpoint));
+        games.back()->start(std::chrono::milliseconds(uint64_t(options.ramp) * 1000 * i / options.games));
+    }
+
+    std::printf("%u games (%u connections) to %s:%u, %u s, %u threads, think %u-%u ms\n", options.games,
+                options.games * 2, options.host.c_str(), options.port, options.duration, options.threads,
+                options.thinkMinMs, options.thinkMaxMs);
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) {
+        threads.emplace_back([&worker] { worker->io.run(); });
+    }
+
+    // Строка в секунду: подключения, игры и выстрелы за последнюю секунду
+    auto start = Clock::now();
+    uint64_t lastShots = 0, lastGames = 0;
+    for (unsigned second = 1; second <= options.duration; ++second) {
+        std::this_thread::sleep_until(start + std::chrono::seconds(second));
+        uint64_t shots = sum(workers, &Stats::shots);
+        uint64_t finished = sum(workers, &Stats::gamesFinished);
+        std::printf("[%4us] connections %llu, games/s %llu, shots/s %llu, errors %llu\n", second,
+                    static_cast<unsigned long long>(sum(workers, &Stats::connected) - sum(workers, &Stats::disconnects)),
+                    static_cast<unsigned long long>(finished - lastGames),
+                    static_cast<unsigned long long>(shots - lastShots),
+                    static_cast<unsigned long long>(sum(workers, &Stats::connectErrors) +
+                                                    sum(workers, &Stats::disconnects) +
+                                                    sum(workers, &Stats::serverErrors)));
+        std::fflush(stdout);
+        lastShots = shots;
+        lastGames = finished;
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (size_t i = 0; i < games.size(); ++i) {
+        crow::asio::post(workers[i % workers.size()]->io, [game = games[i].get()] { game->stop(); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<uint32_t> rtt;
+    for (const auto& worker : workers) {
+        rtt.insert(rtt.end(), worker->stats.shotRttUs.begin(), worker->stats.shotRttUs.end());
+    }
+    std::sort(rtt.begin(), rtt.end());
+    auto percentile = [&](double p) { return rtt.empty() ? 0u : rtt[static_cast<size_t>(p * (rtt.size() - 1))]; };
+
+    auto count = [&](auto field) { return static_cast<unsigned long long>(sum(workers, field)); };
+    std::printf("\nconnections: %llu opened, %llu failed to connect, %llu dropped\n", count(&Stats::connected),
+                count(&Stats::connectErrors), count(&Stats::disconnects));
+    std::printf("games: %llu finished (%.1f/s), %llu abandoned, server errors: %llu\n", count(&Stats::gamesFinished),
+                count(&Stats::gamesFinished) / elapsed, count(&Stats::gamesAbandoned), count(&Stats::serverErrors));
+    std::printf("shots: %llu (%.0f/s)\n", count(&Stats::shots), count(&Stats::shots) / elapsed);
+    std::printf("shot rtt us: p50 %u, p90 %u, p99 %u, p999 %u, max %u\n", percentile(0.5), percentile(0.9),
+                percentile(0.99), percentile(0.999), rtt.empty() ? 0u : rtt.back());
+    return count(&Stats::connected) > 0 ? 0 : 1;
+}
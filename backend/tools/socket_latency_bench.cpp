@@ -0,0 +1,146 @@
+// Замер задержки хода при разных параметрах TCP (TCP_NODELAY, TCP_QUICKACK,
+// SO_BUSY_POLL).
+//
+// Поднимает в процессе Crow с маршрутом /ws, который отвечает на SHOT как
+// сервер игры: сразу отправляет STATE (~1.5 КБ), а через 200 мкс отдельной
+// записью - событие соперника (YOUR_TURN). Вторая запись уходит, пока первая
+// еще не подтверждена клиентом, поэтому без TCP_NODELAY алгоритм Нейгла
+// задерживает ее до ACK, который клиент откладывает (delayed ACK).
+// Клиент делает ходы по одному и ждет оба сообщения; время хода - от
+// отправки SHOT до получения YOUR_TURN. Каждый набор параметров запускается
+// на отдельном сервере.
+//
+// Сборка: cmake -DSEA_BATTLE_BUILD_TOOLS=ON
+// Запуск: socket_latency_bench [ходов на набор=500]
+
+#include <crow.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const std::string kShot = R"({"type":"SHOT","cords":[4,7]})";
+const std::string kState = R"({"type":"STATE","mode":"MY_SHOT","data":")" + std::string(1400, 'x') + R"("})";
+const std::string kYourTurn = R"({"type":"YOUR_TURN"})";
+
+struct Config {
+    const char* name;
+    crow::socket_options options;
+};
+
+std::string clientFrame(const std::string& payload) {
+    std::string frame;
+    frame.push_back(static_cast<char>(0x81));
+    frame.push_back(static_cast<char>(0x80 | payload.size()));
+    frame.append(4, '\0');
+    frame += payload;
+    return frame;
+}
+
+// Чтение одного кадра сервера (без маски), возвращает содержимое
+std::string readFrame(crow::tcp::socket& socket) {
+    unsigned char header[2];
+    crow::asio::read(socket, crow::asio::buffer(header, 2));
+    uint64_t size = header[1] & 0x7f;
+    if (size == 126) {
+        unsigned char ext[2];
+        crow::asio::read(socket, crow::asio::buffer(ext, 2));
+        size = (ext[0] << 8) | ext[1];
+    } else if (size == 127) {
+        unsigned char ext[8];
+        crow::asio::read(socket, crow::asio::buffer(ext, 8));
+        size = 0;
+        for (unsigned char byte : ext) {
+            size = (size << 8) | byte;
+        }
+    }
+    std::string payload(size, '\0');
+    crow::asio::read(socket, crow::asio::buffer(&payload[0], size));
+    return payload;
+}
+
+std::vector<uint32_t> run(const crow::socket_options& options, int shots) {
+    crow::SimpleApp app;
+    app.loglevel(crow::LogLevel::Warning);
+
+    // Отдельный поток для второй записи: она должна уйти не вместе с первой
+    crow::asio::io_context delayed;
+    auto work = crow::asio::make_work_guard(delayed);
+    std::thread delayedThread([&delayed] { delayed.run(); });
+
+    CROW_WEBSOCKET_ROUTE(app, "/ws")
+      .onmessage([&delayed](crow::websocket::connection& conn, const std::string&, bool) {
+          conn.send_text(kState);
+          auto timer = std::make_shared<crow::asio::steady_timer>(delayed, std::chrono::microseconds(200));
+          timer->async_wait([timer, &conn](const crow::error_code&) {
+              conn.send_text(kYourTurn);
+          });
+      });
+    auto server = app.bindaddr("127.0.0.1").port(0).concurrency(2).socket_options(options).run_async();
+    app.wait_for_server_start();
+
+    crow::asio::io_context io;
+    crow::tcp::socket socket(io);
+    socket.connect({crow::asio::ip::make_address("127.0.0.1"), app.port()});
+    std::string request =
+      "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    crow::asio::write(socket, crow::asio::buffer(request));
+    crow::asio::streambuf response;
+    crow::asio::read_until(socket, response, "\r\n\r\n");
+
+    std::string frame = clientFrame(kShot);
+    std::vector<uint32_t> latencies;
+    for (int i = 0; i < shots; ++i) {
+        auto start = Clock::now();
+        crow::asio::write(socket, crow::asio::buffer(frame));
+        while (readFrame(socket) != kYourTurn) {
+        }
+        latencies.push_back(static_cast<uint32_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+        // Игрок думает над ходом: отложенный ACK клиента успевает сработать
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    socket.close();
+    app.stop();
+    server.wait();
+    work.reset();
+    delayedThread.join();
+    return latencies;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int shots = argc > 1 ? std::atoi(argv[1]) : 500;
+
+    std::vector<Config> configs(4);
+    configs[0].name = "defaults";
+    configs[1].name = "nodelay";
+    configs[1].options.no_delay = true;
+    configs[2].name = "nodelay+quickack";
+    configs[2].options.no_delay = true;
+    configs[2].options.quick_ack = true;
+    configs[3].name = "nodelay+quickack+busypoll";
+    configs[3].options.no_delay = true;
+    configs[3].options.quick_ack = true;
+    configs[3].options.busy_poll_us = 50;
+
+    std::printf("%-28s %10s %10s %10s\n", "options", "p50 us", "p99 us", "max us");
+    for (const auto& config : configs) {
+        auto latencies = run(config.options, shots);
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+        std::printf("%-28s %10u %10u %10u\n", config.name, percentile(0.5), percentile(0.99), latencies.back());
+    }
+    return 0;
+}
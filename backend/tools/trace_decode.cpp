@@ -0,0 +1,209 @@
+// Разбор двоичной трассы игр (--trace-dir, include/game_trace.h).
+//
+// По умолчанию печатает записи всех файлов по времени, по одной в строке.
+// С --summary выводит сводку: число сообщений и процентили времени обработки
+// по типам, соединения, комнаты и выстрелы. --room=КОД оставляет записи одной
+// комнаты, включая открытие соединений, которые потом в нее вошли.
+//
+// Сборка: cmake -DSEA_BATTLE_BUILD_TOOLS=ON
+// Запуск: trace_decode [--summary] [--room=КОД] файл.sbt...
+
+#include "../include/game_trace.h"
+#include "../include/metrics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Record = GameTrace::Record;
+
+bool readFile(const char* path, std::vector<Record>& records) {
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        std::fprintf(stderr, "%s: %s\n", path, std::strerror(errno));
+        return false;
+    }
+    GameTrace::FileHeader header{};
+    bool valid = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                 std::memcmp(header.magic, GameTrace::kMagic, sizeof(GameTrace::kMagic)) == 0;
+    if (!valid) {
+        std::fprintf(stderr, "%s: not a game trace\n", path);
+    } else if (header.version != GameTrace::kVersion || header.recordSize != sizeof(Record)) {
+        std::fprintf(stderr, "%s: unsupported trace version %u (record size %u)\n", path, header.version,
+                     header.recordSize);
+        valid = false;
+    } else {
+        Record record;
+        while (std::fread(&record, sizeof(record), 1, file) == 1) {
+            records.push_back(record);
+        }
+        // Хвост неполной записи остается, если процесс остановили во время записи
+    }
+    std::fclose(file);
+    return valid;
+}
+
+std::string roomName(uint32_t room) {
+    if (room == GameTrace::kNoRoom) {
+        return "-";
+    }
+    char name[16];
+    std::snprintf(name, sizeof(name), "%06X", room);
+    return name;
+}
+
+const char* typeName(const Record& record) {
+    if (record.event == GameTrace::Open) return "OPEN";
+    if (record.event == GameTrace::Close) return "CLOSE";
+    if (record.messageType >= Metrics::kMessageTypeCount) return "unparsed";
+    return Metrics::messageTypeName(record.messageType);
+}
+
+const char* resultName(uint8_t result) {
+    static const char* names[] = {"", "MISS", "HIT", "KILL", "WIN"};
+    return result < 5 ? names[result] : "?";
+}
+
+void printTime(uint64_t ns) {
+    time_t seconds = static_cast<time_t>(ns / 1000000000);
+    tm utc;
+    gmtime_r(&seconds, &utc);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &utc);
+    std::printf("%s.%06u", date, static_cast<unsigned>(ns % 1000000000 / 1000));
+}
+
+void dump(const std::vector<Record>& records) {
+    for (const auto& record : records) {
+        printTime(record.timeNs);
+        std::printf(" conn=%012" PRIx64 " room=%s", record.connection, roomName(record.room).c_str());
+        if (record.player != 0) {
+            std::printf(" p%u", record.player);
+        }
+        std::printf(" %s", typeName(record));
+        if (record.result != GameTrace::kNoShot) {
+            std::printf(" (%u,%u) %s", record.x, record.y, resultName(record.result));
+        }
+        if (record.event == GameTrace::Message) {
+            std::printf(" %u us", record.latencyUs);
+        }
+        std::printf("\n");
+    }
+}
+
+void summary(const std::vector<Record>& records) {
+    std::map<std::string, std::vector<uint32_t>> latencies;
+    std::set<uint32_t> rooms;
+    uint64_t opened = 0, closed = 0;
+    uint64_t shotResults[5] = {};
+    for (const auto& record : records) {
+        if (record.event == GameTrace::Open) {
+            ++opened;
+        } else if (record.event == GameTrace::Close) {
+            ++closed;
+        } else {
+            latencies[typeName(record)].push_back(record.latencyUs);
+        }
+        if (record.room != GameTrace::kNoRoom) {
+            rooms.insert(record.room);
+        }
+        if (record.result < 5) {
+            ++shotResults[record.result];
+        }
+    }
+
+    if (!records.empty()) {
+        double seconds = (records.back().timeNs - records.front().timeNs) / 1e9;
+        std::printf("records: %zu over %.1f s\n", records.size(), seconds);
+    }
+    std::printf("connections: %" PRIu64 " opened, %" PRIu64 " closed\n", opened, closed);
+    std::printf("rooms: %zu, games won: %" PRIu64 "\n", rooms.size(), shotResults[4]);
+    std::printf("shots: %" PRIu64 " (miss %" PRIu64 ", hit %" PRIu64 ", kill %" PRIu64 ")\n\n",
+                shotResults[1] + shotResults[2] + shotResults[3] + shotResults[4], shotResults[1],
+                shotResults[2], shotResults[3]);
+
+    std::printf("%-16s %10s %10s %10s %10s\n", "message", "count", "p50 us", "p99 us", "max us");
+    for (auto& [type, values] : latencies) {
+        std::sort(values.begin(), values.end());
+        auto percentile = [&](double p) { return values[static_cast<size_t>(p * (values.size() - 1))]; };
+        std::printf("%-16s %10zu %10u %10u %10u\n", type.c_str(), values.size(), percentile(0.5),
+                    percentile(0.99), values.back());
+    }
+}
+
+// Записи комнаты и соединений, которые в ней были
+std::vector<Record> filterRoom(const std::vector<Record>& records, uint32_t room) {
+    std::set<uint64_t> connections;
+    for (const auto& record : records) {
+        if (record.room == room) {
+            connections.insert(record.connection);
+        }
+    }
+    std::vector<Record> result;
+    for (const auto& record : records) {
+        if (record.room == room || (record.room == GameTrace::kNoRoom && connections.count(record.connection))) {
+            result.push_back(record);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool showSummary = false;
+    std::string room;
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--summary") == 0) {
+            showSummary = true;
+        } else if (std::strncmp(argv[i], "--room=", 7) == 0) {
+            room = argv[i] + 7;
+            for (auto& c : room) {
+                c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            }
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        std::fprintf(stderr, "usage: %s [--summary] [--room=CODE] trace.sbt...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<Record> records;
+    bool ok = true;
+    for (const char* path : paths) {
+        ok = readFile(path, records) && ok;
+    }
+    // Потоки сервера сбрасывают свои буферы по очереди, поэтому в файле
+    // записи упорядочены только в пределах потока
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record& a, const Record& b) { return a.timeNs < b.timeNs; });
+
+    if (!room.empty()) {
+        uint32_t code = GameTrace::encodeRoom(room);
+        if (code == GameTrace::kNoRoom) {
+            std::fprintf(stderr, "invalid room code: %s\n", room.c_str());
+            return 2;
+        }
+        records = filterRoom(records, code);
+    }
+
+    if (showSummary) {
+        summary(records);
+    } else {
+        dump(records);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+// Проверка и замер снятия маски WebSocket (crow::websocket::detail::unmask).
+//
+// Сначала результат сравнивается с побайтовым циклом на всех длинах до 300 байт
+// и на смещенных буферах, затем оба варианта замеряются на типичных размерах
+// сообщений. При расхождении программа завершается с кодом 1.
+//
+// Сборка: cmake -DSEA_BATTLE_BUILD_TOOLS=ON (для AVX2 еще -DSEA_BATTLE_NATIVE_ARCH=ON)
+
+#include <crow/websocket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Исходный вариант из handle_fragment
+void unmaskBytewise(char* data, size_t size, uint32_t mask) {
+    for (size_t i = 0; i < size; i++) {
+        data[i] ^= ((char*)&mask)[i % 4];
+    }
+}
+
+bool selfCheck(std::mt19937& rng) {
+    std::vector<char> original(300 + 32);
+    for (auto& c : original) {
+        c = static_cast<char>(rng());
+    }
+
+    for (int round = 0; round < 16; ++round) {
+        uint32_t mask = static_cast<uint32_t>(rng());
+        for (size_t offset = 0; offset < 32; offset += 7) {
+            for (size_t size = 0; size + offset <= original.size() && size <= 300; ++size) {
+                std::vector<char> expected(original), actual(original);
+                unmaskBytewise(expected.data() + offset, size, mask);
+                crow::websocket::detail::unmask(actual.data() + offset, size, mask);
+                if (expected != actual) {
+                    std::printf("MISMATCH: mask=%08x offset=%zu size=%zu\n", mask, offset, size);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Fn>
+double nsPerCall(Fn fn, std::string& buffer, uint32_t mask) {
+    // Число повторов подбирается так, чтобы через функцию прошло ~256 МБ
+    size_t iterations = std::max<size_t>(1000, (256u << 20) / std::max<size_t>(buffer.size(), 1));
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        fn(&buffer[0], buffer.size(), mask);
+        // Не даем компилятору выбросить повторы
+        asm volatile("" : : "r"(buffer.data()) : "memory");
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 rng(42);
+    if (!selfCheck(rng)) {
+        return 1;
+    }
+    std::printf("self-check: OK\n");
+
+#if defined(__AVX2__)
+    const char* isa = "AVX2";
+#elif defined(__SSE2__)
+    const char* isa = "SSE2";
+#else
+    const char* isa = "64-bit words";
+#endif
+    std::printf("vector path: %s\n\n", isa);
+    std::printf("%8s %14s %14s %10s\n", "bytes", "bytewise ns", "unmask ns", "speedup");
+
+    // PING, SHOT, PLACE_SHIPS (~400 байт) и крупные бинарные сообщения
+    const uint32_t mask = static_cast<uint32_t>(rng());
+    for (size_t size : {16, 48, 400, 1024, 4096, 65536}) {
+        std::string buffer(size, 'x');
+        double bytewise = nsPerCall(unmaskBytewise, buffer, mask);
+        double vectorized = nsPerCall(crow::websocket::detail::unmask, buffer, mask);
+        std::printf("%8zu %14.1f %14.1f %9.1fx\n", size, bytewise, vectorized, bytewise / vectorized);
+    }
+    return 0;
+}
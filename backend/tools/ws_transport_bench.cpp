@@ -0,0 +1,215 @@
+// Замер транспорта WebSocket: epoll против io_uring, TCP против unix socket.
+//
+// Поднимает в процессе Crow с эхо-маршрутом /ws на локальном TCP порту или
+// на unix socket (как за nginx на той же машине) и гоняет через него
+// короткие сообщения размером с SHOT от локальных клиентов: каждый клиент
+// отправляет сообщение, ждет эхо и сразу отправляет следующее. Клиенты
+// работают на том же asio, что и сервер, поэтому весь путь сообщения идет
+// через выбранный при сборке механизм ввода-вывода. Выводит число сообщений
+// в секунду, задержку (p50/p99) и процессорное время (user/sys).
+//
+// Сборка: cmake -DSEA_BATTLE_BUILD_TOOLS=ON собирает ws_transport_bench_epoll,
+// а с -DSEA_BATTLE_IO_URING=ON еще и ws_transport_bench_uring - их запускают
+// по очереди с одинаковыми параметрами.
+//
+// Запуск: ws_transport_bench_epoll [клиенты=64] [секунды=5] [потоки сервера=2] [tcp|unix]
+
+#include <crow.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Типичное сообщение игры
+const std::string kPayload = R"({"type":"SHOT","cords":[4,7]})";
+
+// Кадр клиента: FIN + текст, маска нулевая, чтобы не тратить время клиента
+std::string maskedFrame(const std::string& payload) {
+    std::string frame;
+    frame.push_back(static_cast<char>(0x81));
+    frame.push_back(static_cast<char>(0x80 | payload.size()));
+    frame.append(4, '\0');
+    frame += payload;
+    return frame;
+}
+
+// Protocol - crow::tcp или crow::stream_protocol (unix socket)
+template <typename Protocol>
+class Client : public std::enable_shared_from_this<Client<Protocol>> {
+public:
+    Client(crow::asio::io_context& io, std::atomic<bool>& running):
+      socket_(io), running_(running), frame_(maskedFrame(kPayload)) {}
+
+    bool connect(const typename Protocol::endpoint& endpoint) {
+        crow::error_code ec;
+        socket_.connect(endpoint, ec);
+        if (ec) {
+            return false;
+        }
+        if constexpr (std::is_same_v<Protocol, crow::tcp>) {
+            socket_.set_option(crow::tcp::no_delay(true));
+        }
+        std::string request =
+          "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+        crow::asio::write(socket_, crow::asio::buffer(request), ec);
+        crow::asio::streambuf response;
+        crow::asio::read_until(socket_, response, "\r\n\r\n", ec);
+        return !ec;
+    }
+
+    void start() { send(); }
+
+    std::vector<uint32_t>& latencies() { return latenciesUs_; }
+
+private:
+    void send() {
+        sentAt_ = Clock::now();
+        crow::asio::async_write(socket_, crow::asio::buffer(frame_),
+          [self = this->shared_from_this()](const crow::error_code& ec, size_t) {
+              if (!ec) {
+                  self->receive();
+              }
+          });
+    }
+
+    void receive() {
+        // Эхо без маски: 2 байта заголовка и то же содержимое
+        crow::asio::async_read(socket_, crow::asio::buffer(reply_.data(), 2 + kPayload.size()),
+          [self = this->shared_from_this()](const crow::error_code& ec, size_t) {
+              if (ec) {
+                  return;
+              }
+              auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - self->sentAt_);
+              self->latenciesUs_.push_back(static_cast<uint32_t>(rtt.count()));
+              if (self->running_) {
+                  self->send();
+              }
+          });
+    }
+
+    typename Protocol::socket socket_;
+    std::atomic<bool>& running_;
+    std::string frame_;
+    std::array<char, 256> reply_;
+    Clock::time_point sentAt_;
+    std::vector<uint32_t> latenciesUs_;
+};
+
+double cpuSeconds(const timeval& tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct Result {
+    std::vector<uint32_t> latenciesUs;
+    double elapsed = 0;
+    rusage before{};
+    rusage after{};
+};
+
+template <typename Protocol>
+bool runClients(int clients, int seconds, const typename Protocol::endpoint& endpoint, Result& result) {
+    crow::asio::io_context io;
+    std::atomic<bool> running{true};
+    std::vector<std::shared_ptr<Client<Protocol>>> pool;
+    for (int i = 0; i < clients; ++i) {
+        auto client = std::make_shared<Client<Protocol>>(io, running);
+        if (!client->connect(endpoint)) {
+            std::fprintf(stderr, "client %d failed to connect\n", i);
+            return false;
+        }
+        pool.push_back(client);
+    }
+
+    getrusage(RUSAGE_SELF, &result.before);
+    auto start = Clock::now();
+    for (auto& client : pool) {
+        client->start();
+    }
+    std::thread stopper([&] {
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        running = false;
+    });
+    io.run();
+    stopper.join();
+    result.elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    getrusage(RUSAGE_SELF, &result.after);
+
+    for (auto& client : pool) {
+        result.latenciesUs.insert(result.latenciesUs.end(), client->latencies().begin(), client->latencies().end());
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int clients = argc > 1 ? std::atoi(argv[1]) : 64;
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 5;
+    int serverThreads = argc > 3 ? std::atoi(argv[3]) : 2;
+    bool unixSocket = argc > 4 && std::string(argv[4]) == "unix";
+    std::string socketPath = "/tmp/ws_transport_bench." + std::to_string(::getpid()) + ".sock";
+
+    crow::SimpleApp app;
+    app.loglevel(crow::LogLevel::Warning);
+    CROW_WEBSOCKET_ROUTE(app, "/ws")
+      .onmessage([](crow::websocket::connection& conn, const std::string& data, bool) {
+          conn.send_text(data);
+      });
+    // Один поток сервера занят приемом соединений
+    if (unixSocket) {
+        app.local_socket_path(socketPath);
+    } else {
+        app.bindaddr("127.0.0.1").port(0);
+    }
+    auto server = app.concurrency(serverThreads + 1).run_async();
+    if (app.wait_for_server_start() != std::cv_status::no_timeout) {
+        std::fprintf(stderr, "server did not start\n");
+        return 1;
+    }
+
+    Result result;
+    bool ok = unixSocket
+      ? runClients<crow::stream_protocol>(clients, seconds, crow::stream_protocol::endpoint(socketPath), result)
+      : runClients<crow::tcp>(clients, seconds, {crow::asio::ip::make_address("127.0.0.1"), app.port()}, result);
+    app.stop();
+    server.wait();
+    if (unixSocket) {
+        ::unlink(socketPath.c_str());
+    }
+    if (!ok) {
+        return 1;
+    }
+
+    auto& latencies = result.latenciesUs;
+    if (latencies.empty()) {
+        std::fprintf(stderr, "no messages echoed\n");
+        return 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+
+    std::printf("backend: %s, transport: %s, clients: %d, server threads: %d, %d s\n",
+                crow::io_backend_name(), unixSocket ? "unix" : "tcp", clients, serverThreads, seconds);
+    std::printf("messages/s: %.0f\n", latencies.size() / result.elapsed);
+    std::printf("latency us: p50 %u, p99 %u, max %u\n", percentile(0.5), percentile(0.99), latencies.back());
+    std::printf("cpu s: user %.2f, sys %.2f (server and clients)\n",
+                cpuSeconds(result.after.ru_utime) - cpuSeconds(result.before.ru_utime),
+                cpuSeconds(result.after.ru_stime) - cpuSeconds(result.before.ru_stime));
+    return 0;
+}
@@ -3,6 +3,15 @@ type OpenHandler = () => void;
 type ErrorHandler = (error: Event) => void;
 type CloseHandler = (event: CloseEvent) => void;
 
+/** Данные для возврата в игру после разрыва соединения (RESUME) */
+interface ResumeState {
+  roomCode: string;
+  token: string;
+  lastSeq: number;
+}
+
+const MAX_RESUME_ATTEMPTS = 5;
+
 export class GameWebSocket {
   private socket: WebSocket | null = null;
   private messageHandlers: Set<MessageHandler> = new Set();
@@ -10,10 +19,19 @@ export class GameWebSocket {
   private errorHandlers: Set<ErrorHandler> = new Set();
   private closeHandlers: Set<CloseHandler> = new Set();
   private url: string;
+  private baseUrl: string;
   private isConnecting: boolean = false;
+  private resumeState: ResumeState | null = null;
+  private resumeAttempts: number = 0;
+  private isResuming: boolean = false;
+  /** Последний JOIN_SESSION: повторяется на нужном шарде после REDIRECT */
+  private pendingJoin: object | null = null;
+  /** Сообщение, которое нужно отправить сразу после переподключения */
+  private redirectMessage: object | null = null;
 
   constructor(url: string = "/ws") {
     this.url = url;
+    this.baseUrl = url;
   }
 
   /**
@@ -56,14 +74,24 @@ export class GameWebSocket {
         this.socket.onopen = () => {
           console.log("[GameWebSocket] onopen fired");
           this.isConnecting = false;
-          this.notifyOpenHandlers();
+          if (this.redirectMessage) {
+            this.send(this.redirectMessage);
+            this.redirectMessage = null;
+          } else if (this.isResuming) {
+            this.sendResume();
+          } else {
+            this.notifyOpenHandlers();
+          }
           resolve();
         };
 
         this.socket.onerror = (error) => {
           console.error("[GameWebSocket] onerror fired:", error);
           this.isConnecting = false;
-          this.notifyErrorHandlers(error);
+          // Во время RESUME ошибка не фатальна: onclose запустит следующую попытку
+          if (!this.isResuming) {
+            this.notifyErrorHandlers(error);
+          }
           reject(error);
         };
 
@@ -75,11 +103,18 @@ export class GameWebSocket {
             event.reason
           );
           this.isConnecting = false;
+          if (event.code !== 1000 && this.tryResume()) {
+            return;
+          }
           this.notifyCloseHandlers(event);
         };
 
         this.socket.onmessage = (event) => {
           console.log("[GameWebSocket] onmessage:", event.data);
+          if (this.handleRedirect(event.data) || this.isDuplicate(event.data)) {
+            return;
+          }
+          this.trackResumeState(event.data);
           this.notifyMessageHandlers(event);
         };
       } catch (error) {
@@ -101,6 +136,11 @@ export class GameWebSocket {
       reason
     );
     console.trace("[GameWebSocket] disconnect stack trace:");
+    this.resumeState = null;
+    this.isResuming = false;
+    this.pendingJoin = null;
+    this.redirectMessage = null;
+    this.url = this.baseUrl;
     if (this.socket) {
       this.socket.close(code, reason);
       this.socket = null;
@@ -116,6 +156,9 @@ export class GameWebSocket {
       throw new Error("WebSocket is not connected");
     }
 
+    if (typeof data === "object" && (data as { type?: string }).type === "JOIN_SESSION") {
+      this.pendingJoin = data;
+    }
     const message = typeof data === "string" ? data : JSON.stringify(data);
     this.socket.send(message);
   }
@@ -185,6 +228,129 @@ export class GameWebSocket {
     return this.socket?.readyState === WebSocket.OPEN;
   }
 
+  /**
+   * Запоминает токен переподключения и номер последнего события
+   */
+  private trackResumeState(data: unknown): void {
+    if (typeof data !== "string") return;
+    try {
+      const message = JSON.parse(data);
+      if (message.reconnectToken && message.roomCode) {
+        this.resumeState = {
+          roomCode: message.roomCode,
+          token: message.reconnectToken,
+          lastSeq: this.resumeState?.lastSeq ?? 0,
+        };
+      }
+      if (!this.resumeState) return;
+      if (message.type === "RESUMED") {
+        this.resumeState.lastSeq = message.lastSeq;
+        this.resumeAttempts = 0;
+        this.isResuming = false;
+      } else if (typeof message.seq === "number") {
+        this.resumeState.lastSeq = message.seq;
+      }
+      if (message.type === "GAME_OVER") {
+        this.resumeState = null;
+      }
+    } catch {
+      // Не JSON - не влияет на состояние переподключения
+    }
+  }
+
+  /**
+   * Комната живет на другом процессе сервера: переподключаемся с ?room=,
+   * чтобы nginx направил соединение на нужный шард, и повторяем запрос
+   */
+  private handleRedirect(data: unknown): boolean {
+    if (typeof data !== "string") return false;
+    let message;
+    try {
+      message = JSON.parse(data);
+    } catch {
+      return false;
+    }
+    if (message.type !== "REDIRECT") return false;
+
+    const retry = this.isResuming ? null : this.pendingJoin;
+    this.pendingJoin = null;
+    this.url = this.roomUrl(message.roomCode);
+    console.log("[GameWebSocket] Redirected to", this.url);
+
+    if (this.socket) {
+      this.socket.onclose = null;
+      this.socket.onerror = null;
+      this.socket.onmessage = null;
+      this.socket.close(1000, "Redirect");
+      this.socket = null;
+    }
+    this.redirectMessage = retry;
+    this.connect().catch((error) => {
+      console.error("[GameWebSocket] Redirect connect failed:", error);
+    });
+    return true;
+  }
+
+  private roomUrl(roomCode: string): string {
+    const separator = this.baseUrl.includes("?") ? "&" : "?";
+    return `${this.baseUrl}${separator}room=${encodeURIComponent(roomCode)}`;
+  }
+
+  /**
+   * Событие с уже полученным номером (сервер может дослать его повторно
+   * после переподключения или перезапуска) - обрабатывать не нужно
+   */
+  private isDuplicate(data: unknown): boolean {
+    if (typeof data !== "string" || !this.resumeState) return false;
+    try {
+      const message = JSON.parse(data);
+      return (
+        typeof message.seq === "number" &&
+        (!message.reconnectToken ||
+          message.reconnectToken === this.resumeState.token) &&
+        message.seq <= this.resumeState.lastSeq
+      );
+    } catch {
+      return false;
+    }
+  }
+
+  /**
+   * Пробует вернуться в игру после неожиданного разрыва соединения
+   */
+  private tryResume(): boolean {
+    if (!this.resumeState || this.resumeAttempts >= MAX_RESUME_ATTEMPTS) {
+      return false;
+    }
+    this.resumeAttempts++;
+    this.isResuming = true;
+    this.url = this.roomUrl(this.resumeState.roomCode);
+    const delay = Math.min(500 * 2 ** (this.resumeAttempts - 1), 5000);
+    console.log(
+      "[GameWebSocket] Connection lost, resume attempt",
+      this.resumeAttempts,
+      "in",
+      delay,
+      "ms"
+    );
+    setTimeout(() => {
+      this.connect().catch((error) => {
+        console.error("[GameWebSocket] Resume connect failed:", error);
+      });
+    }, delay);
+    return true;
+  }
+
+  private sendResume(): void {
+    if (!this.resumeState) return;
+    this.send({
+      type: "RESUME",
+      roomCode: this.resumeState.roomCode,
+      token: this.resumeState.token,
+      lastSeq: this.resumeState.lastSeq,
+    });
+  }
+
   // Приватные методы для уведомления подписчиков
   private notifyMessageHandlers(event: MessageEvent): void {
     this.messageHandlers.forEach((handler) => {
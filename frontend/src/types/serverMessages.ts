@@ -50,12 +50,15 @@ export interface GameStats {
 export interface SessionCreatedMessage {
   type: "SESSION_CREATED";
   roomCode: string;
+  reconnectToken: string;
 }
 
 /** Сообщение о начале игры */
 export interface GameStartMessage {
   type: "GAME_START";
   firstTurn: string; // "player1" или "player2"
+  roomCode: string;
+  reconnectToken: string;
 }
 
 /** Сообщение о размещении кораблей */
@@ -106,6 +109,32 @@ export interface YourTurnMessage {
   type: "YOUR_TURN";
 }
 
+/** Соединение снова привязано к месту в игре */
+export interface ResumedMessage {
+  type: "RESUMED";
+  roomCode: string;
+  player: string; // "player1" или "player2"
+  lastSeq: number; // События после этого номера будут досланы
+  fullSync: boolean; // true - вместо истории придет текущее состояние
+}
+
+/** Противник вернулся в игру */
+export interface OpponentReconnectedMessage {
+  type: "OPPONENT_RECONNECTED";
+}
+
+/** Комната обслуживается другим процессом сервера (обрабатывается в GameWebSocket) */
+export interface RedirectMessage {
+  type: "REDIRECT";
+  roomCode: string;
+}
+
+/** Сервер останавливается: новые игры не начинаются, текущую нужно закончить за deadline секунд */
+export interface ServerDrainingMessage {
+  type: "SERVER_DRAINING";
+  deadline: number;
+}
+
 // ==================== Объединенный тип ====================
 
 /** Все возможные сообщения от сервера */
@@ -119,7 +148,11 @@ export type ServerMessage =
   | GameOverMessage
   | ErrorMessage
   | PongMessage
-  | YourTurnMessage;
+  | YourTurnMessage
+  | ResumedMessage
+  | OpponentReconnectedMessage
+  | RedirectMessage
+  | ServerDrainingMessage;
 
 // ==================== Type Guards ====================
 